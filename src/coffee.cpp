@@ -7,12 +7,13 @@
 
 #include "coffee.h"
 
+#include "logpaths.h"
+
 #include <QDataStream>
 #include <QDateTime>
 #include <QDebug>
 #include <QDir>
 #include <QMap>
-#include <QRegularExpression>
 #include <QStandardPaths>
 #include <QTimer>
 
@@ -90,12 +91,7 @@ class Coffee::Private
 
 public:
     Private(const QString& roomName)
-        : m_saveFileName(
-            [](QString s)
-            {
-                s.remove(QRegularExpression("[^a-zA-Z0-9_-]"));
-                return QString("cookiejar-%1").arg(s);
-            }(roomName))
+        : m_saveFileName(QString("cookiejar-%1").arg(LogPaths::sanitize(roomName, LogPaths::Dashes::Keep)))
     {
         QObject::connect(&m_refill, &QTimer::timeout, [this]() { this->addCookie(); });
         m_refill.start(3579100);  // every hour, -ish
@@ -104,10 +100,9 @@ public:
 
     void stats(Bot* bot)
     {
-        const auto roomUsers = bot->userIds();
         for (const auto& u : m_stats)
         {
-            if (!roomUsers.contains(u.m_user))
+            if (!bot->isMember(u.m_user))
             {
                 // We have data on a user, but they are no longer in the room
                 continue;
@@ -419,6 +414,11 @@ const QStringList& Coffee::moduleCommands() const
     return commands;
 }
 
+Coffee::Interests Coffee::interests() const
+{
+    return Interest::Commands;
+}
+
 void Coffee::handleMessage(const Quotient::RoomMessageEvent*) {}
 
 void Coffee::handleCookieCommand(const CommandArgs& cmd)
@@ -437,11 +437,9 @@ void Coffee::handleCookieCommand(const CommandArgs& cmd)
     }
     else if (cmd.command == QStringLiteral("give"))
     {
-        const auto& realUsers = m_bot->userIds();
-
         for (const auto& other : m_bot->userLookup(cmd.args))
         {
-            if (!realUsers.contains(other))
+            if (!m_bot->isMember(other))
             {
                 message(QString("%1 is not here.").arg(other));
                 continue;
@@ -32,6 +32,7 @@ public:
 
     const QString& moduleName() const override;
     const QStringList& moduleCommands() const override;
+    Interests interests() const override;
 
     virtual void handleMessage(const Quotient::RoomMessageEvent*) override;
     virtual void handleCommand(const CommandArgs&) override;
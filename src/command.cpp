@@ -7,6 +7,7 @@
 
 #include "command.h"
 
+#include "outbox.h"
 #include "quatbot.h"
 
 #include <room.h>
@@ -141,9 +142,16 @@ void BasicCommands::handleCommand(const CommandArgs& l)
         message(QString("(quatbot) It is %1. Your message was sent at %2. (Time UTC) "
                         "I can see %3 people in the room. I have processed %4 messages and %5 commands.")
                     .arg(QDateTime::currentDateTimeUtc().toString(), m_lastMessageTime.toString())
-                    .arg(m_bot->userIds().count())
+                    .arg(m_bot->memberCount())
                     .arg(m_messageCount)
                     .arg(m_commandCount));
+        const auto& outbox = m_bot->outbox();
+        message(QString("I have sent %1 messages (%2 queued, %3 lost), taking %4ms on average and %5ms at most.")
+                    .arg(outbox.sentCount())
+                    .arg(outbox.queued())
+                    .arg(outbox.failedCount())
+                    .arg(outbox.averageLatency())
+                    .arg(outbox.maxLatency()));
         for (const auto& w : m_bot->watcherNames())
         {
             auto* watcher = m_bot->getWatcher(w);
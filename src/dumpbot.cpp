@@ -7,12 +7,17 @@
 
 #include "dumpbot.h"
 
+#include "historycache.h"
 #include "log_impl.h"
+#include "logpaths.h"
 
 #include <QCoreApplication>
 #include <QDebug>
 #include <QNetworkReply>
+#include <QDataStream>
+#include <QDir>
 #include <QObject>
+#include <QTemporaryFile>
 #include <QTimer>
 
 #include <connection.h>
@@ -23,9 +28,111 @@
 #include <csapi/joining.h>
 #include <events/roommessageevent.h>
 
+#include <algorithm>
+#include <iterator>
+
 namespace QuatBot
 {
 
+/** @brief Pages of history, written out to a temporary file
+ *
+ * When paginating back, the pages arrive newest-first. Each is
+ * appended to the file (oldest message first) as it arrives, and
+ * the pages are read back last-first, so that the messages come
+ * out oldest-first. Only the page offsets are kept in memory.
+ */
+class PageSpill
+{
+public:
+    bool open()
+    {
+        if (!m_file.open())
+        {
+            qWarning() << "Could not create a temporary file for history.";
+            return false;
+        }
+        return true;
+    }
+
+    /// @brief Writes @p page (text in @p store), which is oldest-first and older than the pages before
+    void append(const MessageList& page, const MessageStore& store)
+    {
+        if (page.empty())
+        {
+            return;
+        }
+        m_file.seek(m_file.size());
+        m_pages.append(m_file.pos());
+        QDataStream out(&m_file);
+        out.setVersion(QDataStream::Qt_5_12);
+        out << qint32(page.size());
+        for (const auto& m : page)
+        {
+            out << m.timestamp();
+            writeView(out, store.id(m));
+            writeView(out, store.senderId(m));
+            writeView(out, store.plainBody(m));
+        }
+        m_count += int(page.size());
+        m_oldest = page.front().originTimestamp();
+    }
+
+    /// @brief Number of messages written
+    int count() const { return m_count; }
+    /// @brief Timestamp of the oldest message written
+    QDateTime oldest() const { return m_oldest; }
+
+    /// @brief Calls @p f with a store and each message written, oldest first
+    template <typename F>
+    void read(F f)
+    {
+        m_file.flush();
+        MessageStore store;  // One page at a time
+        QString id;
+        QString sender;
+        QString body;
+        for (auto it = m_pages.crbegin(); it != m_pages.crend(); ++it)
+        {
+            m_file.seek(*it);
+            QDataStream in(&m_file);
+            in.setVersion(QDataStream::Qt_5_12);
+            qint32 count = 0;
+            in >> count;
+            store.clear();
+            for (qint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i)
+            {
+                qint64 timestamp = 0;
+                in >> timestamp;
+                readView(in, id);
+                readView(in, sender);
+                readView(in, body);
+                f(store, store.add(timestamp, id, sender, body));
+            }
+        }
+    }
+
+private:
+    // The file is only read by this process, so the text is written as-is
+    static void writeView(QDataStream& out, QStringView s)
+    {
+        out << quint32(s.size());
+        out.writeRawData(reinterpret_cast<const char*>(s.utf16()), int(s.size() * sizeof(QChar)));
+    }
+
+    static void readView(QDataStream& in, QString& s)
+    {
+        quint32 size = 0;
+        in >> size;
+        s.resize(int(size));
+        in.readRawData(reinterpret_cast<char*>(s.data()), int(size * sizeof(QChar)));
+    }
+
+    QTemporaryFile m_file;
+    QVector<qint64> m_pages;  ///< Offset of each page, newest page first
+    int m_count = 0;
+    QDateTime m_oldest;
+};
+
 QStringList DumpBot::userIds()
 {
     QStringList l;
@@ -140,6 +247,10 @@ DumpBot::~DumpBot()
 
     delete m_logger;
     m_logger = nullptr;
+    delete m_spill;
+    m_spill = nullptr;
+    delete m_cache;
+    m_cache = nullptr;
 }
 
 
@@ -157,33 +268,43 @@ void DumpBot::baseStateLoaded()
     }
 }
 
-void log_messages(const MessageList& messages, int from, LoggerFile& logger)
+void log_messages(const MessageList& messages, int from, const MessageStore& store, LoggerFile& logger)
 {
     bool first = true;
-    for (int it = from; it < messages.count(); ++it)
+    for (int it = from; it < int(messages.size()); ++it)
     {
         if (first)
         {
-            qDebug() << "Room messages" << from << '-' << (messages.count() - 1)
+            qDebug() << "Room messages" << from << '-' << (messages.size() - 1)
                      << messages[it].originTimestamp().toString() << "arrived"
                      << QDateTime::currentDateTimeUtc().toString();
             first = false;
         }
-        logger.log(messages[it]);
+        logger.log(store, messages[it]);
     }
 }
 
 void DumpBot::finished()
 {
-    if (!isSatisfied())
+    if (m_done)
+    {
+        return;
+    }
+    m_done = true;
+    if (!isSatisfied() && !m_historyEnd)
     {
         qWarning() << "finished() called too soon.";
     }
 
-    if (m_amount > 0)
+    if (m_spill)
+    {
+        logStreamed();
+    }
+    else if (m_amount > 0)
     {
-        const int from = m_amount <= m_messages.count() ? m_messages.count() - m_amount : 0;
-        log_messages(m_messages, from, *m_logger);
+        const int count = int(m_messages.size());
+        const int from = m_amount <= unsigned(count) ? count - int(m_amount) : 0;
+        log_messages(m_messages, from, m_store, *m_logger);
     }
     else
     {
@@ -192,68 +313,216 @@ void DumpBot::finished()
                                   [since = m_since](const MessageData& e) { return since < e.originTimestamp(); });
         if (first != m_messages.end())
         {
-            log_messages(m_messages, std::distance(m_messages.begin(), first), *m_logger);
+            log_messages(m_messages, int(std::distance(m_messages.begin(), first)), m_store, *m_logger);
         }
         else
         {
             qWarning() << "No message after" << m_since;
         }
     }
+    m_logger->flush();
 }
 
-MessageData::MessageData(const Quotient::RoomMessageEvent* p)
-    : m_dt(p->originTimestamp())
-    , m_id(p->id())
-    , m_sender(p->senderId())
-    , m_plainBody(p->plainBody())
+quint64 MessageStore::hashId(QStringView id)
 {
+    // FNV-1a, 64 bits: with that many bits, different ids practically never collide
+    quint64 h = 14695981039346656037ull;
+    for (const QChar c : id)
+    {
+        h = (h ^ c.unicode()) * 1099511628211ull;
+    }
+    return h;
 }
 
+MessageData MessageStore::add(qint64 timestamp, QStringView id, QStringView sender, QStringView body)
+{
+    MessageData m;
+    m.m_timestamp = timestamp;
+    m.m_idHash = hashId(id);
+
+    const QString senderId = sender.toString();
+    auto it = m_senderIndex.constFind(senderId);
+    if (it == m_senderIndex.constEnd())
+    {
+        it = m_senderIndex.insert(senderId, quint32(m_senders.count()));
+        m_senders.append(senderId);
+    }
+    m.m_sender = it.value();
 
-static void organize_messages(MessageList& messages)
+    // A block is never grown beyond its reserved size, so its text does not move
+    static constexpr const int blockSize = 1024 * 1024;
+    const int idLength = qMin(int(id.size()), 0xffff);
+    const int length = idLength + int(body.size());
+    if (m_blocks.isEmpty() || m_blocks.last().size() + length > m_blocks.last().capacity())
+    {
+        m_blocks.append(QString());
+        m_blocks.last().reserve(qMax(blockSize, length));
+    }
+    QString& block = m_blocks.last();
+    m.m_block = quint32(m_blocks.count() - 1);
+    m.m_offset = quint32(block.size());
+    m.m_idLength = quint16(idLength);
+    m.m_bodyLength = quint32(body.size());
+    block.append(id.data(), idLength);
+    block.append(body.data(), int(body.size()));
+    return m;
+}
+
+MessageData MessageStore::add(const Quotient::RoomMessageEvent* p)
+{
+    return add(p->originTimestamp().toMSecsSinceEpoch(), p->id(), p->senderId(), p->plainBody());
+}
+
+void MessageStore::clear()
+{
+    m_blocks.clear();
+    m_senders.clear();
+    m_senderIndex.clear();
+}
+
+void DumpBot::logStreamed()
+{
+    // The spilled pages, then the messages in memory, are oldest-first
+    const int total = m_spill->count() + int(m_messages.size());
+    const int skip = m_amount > 0 && unsigned(total) > m_amount ? total - int(m_amount) : 0;
+    int index = 0;
+    int logged = 0;
+    auto log = [&](const MessageStore& store, const MessageData& m)
+    {
+        if (index++ < skip || (m_since.isValid() && !(m_since < m.originTimestamp())))
+        {
+            return;
+        }
+        m_logger->log(store, m);
+        ++logged;
+    };
+    qDebug() << "Room messages" << skip << '-' << (total - 1) << "arrived"
+             << QDateTime::currentDateTimeUtc().toString();
+    m_spill->read(log);
+    for (const auto& m : m_messages)
+    {
+        log(m_store, m);
+    }
+    if (logged == 0 && m_since.isValid())
+    {
+        qWarning() << "No message after" << m_since;
+    }
+}
+
+
+static bool earlier(const MessageData& a, const MessageData& b)
 {
-    std::sort(messages.begin(),
-              messages.end(),
-              [](const MessageData& a, const MessageData& b) { return a.originTimestamp() < b.originTimestamp(); });
-    auto duplicates = std::unique(
-        messages.begin(), messages.end(), [](const MessageData& a, const MessageData& b) { return a.id() == b.id(); });
-    messages.erase(duplicates, messages.end());
+    return a.timestamp() < b.timestamp();
+}
+
+/** @brief Drops messages seen before from @p chunk, and puts it oldest-first
+ *
+ * Messages whose id is in @p seen already are dropped. A chunk
+ * from the server is in order already (oldest-first, or newest-first
+ * when paginating back), so this is usually linear.
+ */
+static void prepare_chunk(MessageList& chunk, QSet<quint64>& seen)
+{
+    chunk.erase(std::remove_if(chunk.begin(),
+                               chunk.end(),
+                               [&seen](const MessageData& m)
+                               {
+                                   if (seen.contains(m.idHash()))
+                                   {
+                                       return true;
+                                   }
+                                   seen.insert(m.idHash());
+                                   return false;
+                               }),
+                chunk.end());
+    if (chunk.size() > 1 && earlier(chunk.back(), chunk.front()))
+    {
+        std::reverse(chunk.begin(), chunk.end());
+    }
+    if (!std::is_sorted(chunk.cbegin(), chunk.cend(), earlier))
+    {
+        std::stable_sort(chunk.begin(), chunk.end(), earlier);
+    }
+}
+
+/** @brief Merges @p chunk into the (sorted) @p messages
+ *
+ * See prepare_chunk() for @p seen. This is linear in the size of the
+ * chunk when it is all older or all newer than what is there, and
+ * linear in the size of @p messages otherwise.
+ */
+static void merge_messages(MessageList& chunk, MessageList& messages, QSet<quint64>& seen)
+{
+    prepare_chunk(chunk, seen);
+    if (chunk.empty())
+    {
+        return;
+    }
+    if (messages.empty() || !earlier(chunk.front(), messages.back()))
+    {
+        messages.insert(messages.end(), chunk.cbegin(), chunk.cend());
+    }
+    else if (!earlier(messages.front(), chunk.back()))
+    {
+        // Back-pagination: the deque grows at the front in constant time
+        messages.insert(messages.begin(), chunk.cbegin(), chunk.cend());
+    }
+    else
+    {
+        MessageList merged;
+        std::merge(messages.cbegin(),
+                   messages.cend(),
+                   chunk.cbegin(),
+                   chunk.cend(),
+                   std::back_inserter(merged),
+                   earlier);
+        messages.swap(merged);
+    }
 
-    if (messages.isEmpty())
+    if (messages.empty())
     {
         qDebug() << "No messages!";
     }
     else
     {
-        qDebug() << "There are now" << messages.count() << "messages from" << messages.first().originTimestamp() << "to"
-                 << messages.last().originTimestamp();
+        qDebug() << "There are now" << messages.size() << "messages from" << messages.front().originTimestamp() << "to"
+                 << messages.back().originTimestamp();
     }
 }
 
-static void add_messages(const Quotient::Room::Timeline& timeline, MessageList& messages)
+/// @brief Adds timeline items @p from to @p to (inclusive; these are item indexes, not positions)
+static void add_messages(const Quotient::Room::Timeline& timeline,
+                         int from,
+                         int to,
+                         MessageStore& store,
+                         MessageList& messages,
+                         QSet<quint64>& seen)
 {
-    std::for_each(timeline.cbegin(),
-                  timeline.cend(),
-                  [&messages](const Quotient::TimelineItem& i)
-                  {
-                      const QMatrixClient::RoomMessageEvent* event = i.viewAs<QMatrixClient::RoomMessageEvent>();
-                      if (event)
-                      {
-                          messages.append(MessageData(event));
-                      }
-                  });
-    organize_messages(messages);
+    MessageList chunk;
+    const int first = timeline.front().index();
+    for (int i = qMax(from, first) - first; i <= to - first && i < int(timeline.size()); ++i)
+    {
+        const QMatrixClient::RoomMessageEvent* event = timeline[i].viewAs<QMatrixClient::RoomMessageEvent>();
+        if (event)
+        {
+            chunk.push_back(store.add(event));
+        }
+    }
+    merge_messages(chunk, messages, seen);
 }
 
-static void add_messages(const Quotient::RoomEvents& timeline, MessageList& messages)
+static MessageList chunk_messages(const Quotient::RoomEvents& timeline, MessageStore& store)
 {
+    MessageList chunk;
     std::for_each(timeline.cbegin(),
                   timeline.cend(),
-                  [&messages](const std::unique_ptr<Quotient::RoomEvent>& e) {
-                      Quotient::visit(
-                          *e, [&messages](const Quotient::RoomMessageEvent& i) { messages.append(MessageData(&i)); });
+                  [&chunk, &store](const std::unique_ptr<Quotient::RoomEvent>& e)
+                  {
+                      Quotient::visit(*e,
+                                      [&chunk, &store](const Quotient::RoomMessageEvent& i)
+                                      { chunk.push_back(store.add(&i)); });
                   });
-    organize_messages(messages);
+    return chunk;
 }
 
 
@@ -267,46 +536,164 @@ void DumpBot::getMoreHistory()
     }
     else
     {
-        // const QString startId = m_messages.isEmpty() ? m_room->firstDisplayedEventId() : m_messages[0]->id();
-        using GetRoomEventsJob = Quotient::GetRoomEventsJob;
-        qWarning() << "No history job! Starting new one from" << m_previousChunkToken;
-        p = new GetRoomEventsJob(m_room->id(), m_previousChunkToken, QStringLiteral("b"), QString(), 100);
-        connect(p,
-                &GetRoomEventsJob::finished,
-                [p]()
+        requestPage();
+    }
+}
+
+void DumpBot::requestPage()
+{
+    if (m_done || m_historyEnd || m_request || m_pages.count() >= m_maxPages)
+    {
+        return;
+    }
+    HistoryCache::Page cached;
+    if (m_cache && !m_previousChunkToken.isEmpty() && m_cache->find(m_previousChunkToken, pageStore(), cached))
+    {
+        qDebug() << "History from" << m_previousChunkToken << "is cached";
+        addPage(cached.end, cached.messages);
+        requestPage();
+        QTimer::singleShot(0, this, &DumpBot::processPages);
+        return;
+    }
+
+    // const QString startId = m_messages.isEmpty() ? m_room->firstDisplayedEventId() : m_messages[0]->id();
+    using GetRoomEventsJob = Quotient::GetRoomEventsJob;
+    qDebug() << "Requesting history from" << m_previousChunkToken;
+    auto* p = new GetRoomEventsJob(m_room->id(), m_previousChunkToken, QStringLiteral("b"), QString(), 100);
+    m_request = p;
+    connect(p,
+            &GetRoomEventsJob::finished,
+            [p]()
+            {
+                qDebug() << "Extra history job finished";
+                p->deleteLater();
+            });
+    connect(p,
+            &GetRoomEventsJob::failure,
+            [this, p]()
+            {
+                if (m_request == p)
                 {
-                    qDebug() << "Extra history job finished";
-                    p->deleteLater();
-                });
-        connect(p,
-                &GetRoomEventsJob::success,
-                [this, p]()
+                    qWarning() << "Could not get more history, stopping.";
+                    m_request = nullptr;
+                    m_historyEnd = true;
+                    QTimer::singleShot(0, this, &DumpBot::processPages);
+                }
+            });
+    connect(p,
+            &GetRoomEventsJob::success,
+            [this, p]()
+            {
+                if (m_request != p)
                 {
-                    add_messages(p->chunk(), m_messages);
-                    if (!isSatisfied())
-                    {
-                        qDebug() << "Need more";
-                        m_previousChunkToken = p->end();
-                        QTimer::singleShot(0, this, &DumpBot::getMoreHistory);
-                    }
-                    else
-                    {
-                        qDebug() << "All done.";
-                        QTimer::singleShot(0, this, &DumpBot::finished);
-                    }
-                });
-        m_conn.run(p);
+                    return;  // Abandoned
+                }
+                m_request = nullptr;
+                auto&& events = p->chunk();
+                // An empty end token marks the end of history, also in the cache
+                const QString end
+                    = events.empty() || p->end() == m_previousChunkToken ? QString() : QString(p->end());
+                const MessageList chunk = chunk_messages(events, pageStore());
+                HistoryCache::Page cached;
+                bool overlap = false;
+                if (m_cache)
+                {
+                    m_cache->add(m_previousChunkToken, end, chunk, pageStore());
+                    // If the oldest message was fetched before, continue with what was fetched then
+                    const auto oldest = std::min_element(chunk.cbegin(), chunk.cend(), earlier);
+                    overlap = oldest != chunk.cend() && m_cache->findOverlap(*oldest, pageStore(), cached);
+                }
+                addPage(end, chunk);
+                if (overlap)
+                {
+                    qDebug() << "History from" << m_previousChunkToken << "was fetched before";
+                    addPage(cached.end, cached.messages);
+                }
+                // The next page is on its way while this one is processed
+                requestPage();
+                QTimer::singleShot(0, this, &DumpBot::processPages);
+            });
+    m_conn.run(p);
+}
+
+void DumpBot::addPage(const QString& end, const MessageList& chunk)
+{
+    m_historyEnd = end.isEmpty();
+    m_previousChunkToken = end;
+    m_pages.append(chunk);
+}
+
+void DumpBot::processPages()
+{
+    while (!m_pages.isEmpty() && !m_done)
+    {
+        MessageList chunk = m_pages.takeFirst();
+        if (m_spill)
+        {
+            prepare_chunk(chunk, m_seen);
+            if (m_spill->count() > 0)
+            {
+                // Newer messages (from a cached page that reaches forward) were written already
+                const QDateTime oldest = m_spill->oldest();
+                chunk.erase(std::remove_if(chunk.begin(),
+                                           chunk.end(),
+                                           [&oldest](const MessageData& m) { return oldest < m.originTimestamp(); }),
+                            chunk.end());
+            }
+            m_spill->append(chunk, m_pageStore);
+            // Only neighbouring pages (and the room timeline) overlap, so forget the older ids
+            m_seen.clear();
+            for (const auto& m : m_messages)
+            {
+                m_seen.insert(m.idHash());
+            }
+            for (const auto& m : chunk)
+            {
+                m_seen.insert(m.idHash());
+            }
+            if (m_pages.isEmpty())
+            {
+                m_pageStore.clear();
+            }
+        }
+        else
+        {
+            merge_messages(chunk, m_messages, m_seen);
+        }
+        if (isSatisfied())
+        {
+            qDebug() << "All done.";
+            if (m_request)
+            {
+                m_request->abandon();
+                m_request = nullptr;
+            }
+            finished();
+            return;
+        }
+    }
+    if (m_historyEnd)
+    {
+        qDebug() << "No more history.";
+        finished();
+        return;
     }
+    // Processing made room for another page
+    requestPage();
 }
 
 void DumpBot::addedMessages(int from, int to)
 {
     const auto& timeline = m_room->messageEvents();
+    if (timeline.empty())
+    {
+        return;
+    }
     if (!m_showUsersOnly)
     {
-        add_messages(timeline, m_messages);
+        add_messages(timeline, from, to, m_store, m_messages, m_seen);
     }
-    m_room->markMessagesAsRead(timeline[to]->id());
+    m_room->markMessagesAsRead(timeline.back()->id());
     m_logger->flush();
     if (!isSatisfied())
     {
@@ -327,6 +714,55 @@ void DumpBot::setShowUsersOnly(bool u)
     }
 }
 
+void DumpBot::setStreaming(bool streaming)
+{
+    delete m_spill;
+    m_spill = nullptr;
+    if (streaming)
+    {
+        m_spill = new PageSpill;
+        if (!m_spill->open())
+        {
+            delete m_spill;
+            m_spill = nullptr;
+        }
+    }
+}
+
+void DumpBot::setCache(const QString& directory)
+{
+    delete m_cache;
+    m_cache = nullptr;
+    if (directory.isEmpty())
+    {
+        return;
+    }
+    const QString name = LogPaths::sanitize(m_roomName, LogPaths::Dashes::Keep);
+    m_cache = new HistoryCache(QDir(directory).filePath(name + QStringLiteral(".history")));
+    if (!m_cache->open())
+    {
+        delete m_cache;
+        m_cache = nullptr;
+        return;
+    }
+    // The dumper does not stop by itself, so report when it is stopped
+    connect(qApp, &QCoreApplication::aboutToQuit, this, &DumpBot::reportCache, Qt::UniqueConnection);
+}
+
+void DumpBot::reportCache()
+{
+    if (m_cache)
+    {
+        qDebug() << "History cache:" << m_cache->hits() << "pages from the cache," << m_cache->misses()
+                 << "fetched from the server.";
+    }
+}
+
+void DumpBot::setBufferPages(int pages)
+{
+    m_maxPages = qMax(1, pages);
+}
+
 void DumpBot::setLogCriterion(unsigned int count)
 {
     if (count < 1)
@@ -352,11 +788,17 @@ void DumpBot::setLogCriterion(const QDateTime& since)
 
 bool DumpBot::isSatisfied() const
 {
-    if (m_amount && m_messages.count() >= m_amount)
+    const int count = int(m_messages.size()) + (m_spill ? m_spill->count() : 0);
+    if (m_amount && unsigned(count) >= m_amount)
     {
         return true;
     }
-    if (m_since.isValid() && !m_messages.isEmpty() & m_messages.first().originTimestamp() < m_since)
+    // Spilled pages are older than the messages in memory
+    if (m_spill && m_spill->count() > 0)
+    {
+        return m_since.isValid() && m_spill->oldest() < m_since;
+    }
+    if (m_since.isValid() && !m_messages.empty() && m_messages.front().originTimestamp() < m_since)
     {
         return true;
     }
@@ -9,45 +9,95 @@
 #define QUATBOT_DUMPBOT_H
 
 #include <QDateTime>
+#include <QHash>
 #include <QObject>
 #include <QSet>
 #include <QString>
+#include <QStringList>
+#include <QStringView>
 #include <QVector>
 
+#include <deque>
+
 namespace Quotient
 {
 class Connection;
+class GetRoomEventsJob;
 class Room;
 class RoomMessageEvent;
 }  // namespace Quotient
 
 namespace QuatBot
 {
+class HistoryCache;
 class LoggerFile;
+class PageSpill;
 
 /** @brief A compacted form of a room message
  *
  * This contains only the minimum data needed to recreate or display
- * a message in text form.
+ * a message in text form. The text itself lives in a MessageStore,
+ * which returns views of it; the message is small and cheap to copy,
+ * so sorting and merging lists of them is cheap too.
  */
 class MessageData
 {
 public:
-    MessageData() {}
-    MessageData(const Quotient::RoomMessageEvent* p);
+    /// @brief Milliseconds since the epoch
+    qint64 timestamp() const { return m_timestamp; }
+    QDateTime originTimestamp() const { return QDateTime::fromMSecsSinceEpoch(m_timestamp, Qt::UTC); }
+    /// @brief Hash of the event id, to spot duplicates
+    quint64 idHash() const { return m_idHash; }
+
+private:
+    friend class MessageStore;
+
+    qint64 m_timestamp = 0;
+    quint64 m_idHash = 0;
+    quint32 m_block = 0;  ///< Of the store's arena that holds the text
+    quint32 m_offset = 0;  ///< Of the event id in the block; the body follows it
+    quint32 m_bodyLength = 0;
+    quint32 m_sender = 0;  ///< Index into the store's senders
+    quint16 m_idLength = 0;
+};
+
+/// @brief Messages in timestamp order; a deque so that older messages can be put in front cheaply
+using MessageList = std::deque<MessageData>;
 
-    QDateTime originTimestamp() const { return m_dt; }
-    QString id() const { return m_id; }
-    QString senderId() const { return m_sender; }
-    QString plainBody() const { return m_plainBody; }
+/** @brief The text of messages
+ *
+ * Sender ids are interned: each is stored once, and messages refer
+ * to it by index. Event ids and bodies are appended to an arena of
+ * fixed-size blocks (a message never straddles two), so the store
+ * can hold more text than a single QString, and appending never
+ * moves text that is there already. The views returned are valid
+ * until clear().
+ */
+class MessageStore
+{
+public:
+    MessageData add(const Quotient::RoomMessageEvent* p);
+    MessageData add(qint64 timestamp, QStringView id, QStringView sender, QStringView body);
+    void clear();
+
+    QStringView id(const MessageData& m) const
+    {
+        return QStringView(m_blocks[int(m.m_block)]).mid(int(m.m_offset), m.m_idLength);
+    }
+    QStringView senderId(const MessageData& m) const { return m_senders[int(m.m_sender)]; }
+    QStringView plainBody(const MessageData& m) const
+    {
+        return QStringView(m_blocks[int(m.m_block)]).mid(int(m.m_offset) + m.m_idLength, int(m.m_bodyLength));
+    }
+
+    /// @brief The hash used for MessageData::idHash()
+    static quint64 hashId(QStringView id);
 
 private:
-    QDateTime m_dt;
-    QString m_id;
-    QString m_sender;
-    QString m_plainBody;
+    QVector<QString> m_blocks;  ///< The arena; only the last one is appended to
+    QStringList m_senders;
+    QHash<QString, quint32> m_senderIndex;
 };
-using MessageList = QList<MessageData>;
 
 /** @brief Top-level class for the DumpBot
  *
@@ -97,6 +147,35 @@ public:
      */
     void setLogCriterion(unsigned int count);
 
+    /** @brief Sets how many fetched history pages may wait to be processed
+     *
+     * Only one history request is ever on its way: each needs the end
+     * token of the page before it. That request is made as soon as the
+     * previous page arrives, unless @p pages pages (at least 1, default
+     * 2) are already waiting to be processed. Processing happens on the
+     * same thread, so this only overlaps one request with processing;
+     * it does not hide the round-trip time of the requests themselves.
+     */
+    void setBufferPages(int pages);
+
+    /** @brief Sets the streaming mode
+     *
+     * In streaming mode, each page of history is written to a
+     * temporary file as it arrives, instead of being kept in memory
+     * until all the history is there; the file is read back to log
+     * the messages in order at the end. This keeps memory use low,
+     * no matter how far back the history goes.
+     */
+    void setStreaming(bool streaming);
+
+    /** @brief Keeps the history fetched in a cache in @p directory
+     *
+     * Pages of history fetched before (by earlier runs) are served
+     * from the cache instead of fetched again; see HistoryCache.
+     * An empty @p directory switches the cache off.
+     */
+    void setCache(const QString& directory);
+
 protected:
     /// @brief Called once the room is loaded for the first time.
     void baseStateLoaded();
@@ -108,12 +187,24 @@ protected:
 
     /// @brief Tries to get some more history
     void getMoreHistory();
+    /// @brief Requests the next page of history, if there is room for it
+    void requestPage();
+    /// @brief Queues a fetched (or cached) page; an empty @p end token means there is no more history
+    void addPage(const QString& end, const MessageList& chunk);
+    /// @brief Adds the fetched pages to the messages, finishing when satisfied
+    void processPages();
+    /// @brief Where the text of fetched pages goes
+    MessageStore& pageStore() { return m_spill ? m_pageStore : m_store; }
 
     /// @brief Are the since-or-amount settings satisfied?
     bool isSatisfied() const;
 
     /// @brief Called once the history is satisfied, does actual logging.
     void finished();
+    /// @brief Logs the spilled pages and the messages in memory, in streaming mode
+    void logStreamed();
+    /// @brief Prints the history cache statistics, when the dumper quits
+    void reportCache();
 
 private:
     Quotient::Room* m_room = nullptr;
@@ -126,8 +217,19 @@ private:
 
     QDateTime m_since;
     unsigned int m_amount = 100;
-    MessageList m_messages;
+    MessageStore m_store;  ///< Text of m_messages
+    MessageStore m_pageStore;  ///< Text of m_pages, in streaming mode
+    MessageList m_messages;  ///< Sorted by timestamp
+    QSet<quint64> m_seen;  ///< Id hashes of the messages, to skip duplicates
     QString m_previousChunkToken;
+
+    int m_maxPages = 2;  ///< Fetched pages that may wait in m_pages, see setBufferPages()
+    Quotient::GetRoomEventsJob* m_request = nullptr;  ///< In flight, if any
+    QList<MessageList> m_pages;  ///< Fetched, not processed yet
+    bool m_historyEnd = false;  ///< There is no more history to fetch
+    bool m_done = false;
+    PageSpill* m_spill = nullptr;  ///< Only in streaming mode
+    HistoryCache* m_cache = nullptr;
 };
 }  // namespace QuatBot
 
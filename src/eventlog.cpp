@@ -0,0 +1,257 @@
+/*
+ *  SPDX-License-Identifier: BSD-2-Clause
+ *  SPDX-License-File: LICENSE
+ *
+ * Copyright 2026 Adriaan de Groot <groot@kde.org>
+ */
+
+#include "eventlog.h"
+
+#include <QDebug>
+#include <QFileInfo>
+#include <QtEndian>
+
+#include <cstring>
+
+namespace QuatBot
+{
+static const char MAGIC[] = "QBE1";
+static constexpr const int MAGIC_SIZE = 4;
+static constexpr const int LENGTH_SIZE = 4;
+
+template <typename T>
+static void appendLittleEndian(QByteArray& buffer, T value)
+{
+    char bytes[sizeof(T)];
+    qToLittleEndian<T>(value, bytes);
+    buffer.append(bytes, sizeof(T));
+}
+
+template <typename T>
+static T readLittleEndian(const uchar* p)
+{
+    return qFromLittleEndian<T>(p);
+}
+
+EventLogReader::EventLogReader(const QString& fileName)
+    : m_file(fileName)
+{
+    if (!m_file.open(QFile::ReadOnly))
+    {
+        qWarning() << "Could not open event log" << fileName;
+        return;
+    }
+    m_size = m_file.size();
+    if (m_size < MAGIC_SIZE)
+    {
+        return;
+    }
+    m_data = m_file.map(0, m_size);
+    if (!m_data)
+    {
+        qWarning() << "Could not map event log" << fileName;
+        return;
+    }
+    if (std::memcmp(m_data, MAGIC, MAGIC_SIZE) != 0)
+    {
+        qWarning() << "Not an event log" << fileName;
+        m_file.unmap(m_data);
+        m_data = nullptr;
+        return;
+    }
+    m_pos = MAGIC_SIZE;
+}
+
+EventLogReader::~EventLogReader()
+{
+    if (m_data)
+    {
+        m_file.unmap(m_data);
+    }
+}
+
+bool EventLogReader::next(EventRecord& record)
+{
+    // Fixed part of an Event record: timestamp, sender, id length
+    static constexpr const quint32 eventSize = 8 + 4 + 2;
+
+    while (m_data && m_pos + LENGTH_SIZE + 1 <= m_size)
+    {
+        const quint32 length = readLittleEndian<quint32>(m_data + m_pos);
+        if (length < 1 || m_pos + LENGTH_SIZE + length > m_size)
+        {
+            return false;  // Partial (or damaged) record at the end
+        }
+        const uchar* p = m_data + m_pos + LENGTH_SIZE;
+        const auto kind = EventLog::Kind(p[0]);
+        const uchar* payload = p + 1;
+        const quint32 payloadSize = length - 1;
+
+        switch (kind)
+        {
+        case EventLog::Kind::Sender:
+        {
+            if (payloadSize < 4)
+            {
+                return false;
+            }
+            // Senders are written in order, so an index beyond the next one is damage
+            const quint32 index = readLittleEndian<quint32>(payload);
+            if (index > quint32(m_senders.count()))
+            {
+                return false;
+            }
+            const QString sender = QString::fromUtf8(reinterpret_cast<const char*>(payload + 4), int(payloadSize - 4));
+            if (index == quint32(m_senders.count()))
+            {
+                m_senders.append(sender);
+            }
+            else
+            {
+                m_senders[int(index)] = sender;
+            }
+            break;
+        }
+        case EventLog::Kind::Event:
+        {
+            if (payloadSize < eventSize)
+            {
+                return false;
+            }
+            const quint16 idSize = readLittleEndian<quint16>(payload + 12);
+            if (eventSize + idSize > payloadSize)
+            {
+                return false;
+            }
+            const char* id = reinterpret_cast<const char*>(payload + eventSize);
+            record.timestamp = readLittleEndian<qint64>(payload);
+            record.sender = readLittleEndian<quint32>(payload + 8);
+            record.eventId = QByteArray::fromRawData(id, idSize);
+            record.body = QByteArray::fromRawData(id + idSize, int(payloadSize - eventSize - idSize));
+            m_pos += LENGTH_SIZE + length;
+            return true;
+        }
+        }
+        // Sender records, and kinds from the future, are skipped
+        m_pos += LENGTH_SIZE + length;
+    }
+    return false;
+}
+
+EventLogWriter::EventLogWriter(const QString& fileName, bool syncOnClose)
+    : m_fileName(fileName)
+    , m_stream(fileName, syncOnClose)
+{
+}
+
+EventLogWriter::~EventLogWriter()
+{
+    if (m_added)
+    {
+        LogService::instance().remove(&m_stream);
+    }
+}
+
+bool EventLogWriter::open()
+{
+    qint64 valid = 0;
+    const qint64 size = QFileInfo(m_fileName).size();
+    if (size > 0 && size < MAGIC_SIZE)
+    {
+        // Torn while writing the header: there is nothing in it yet
+        qWarning() << "Rewriting incomplete header of" << m_fileName;
+    }
+    else if (size > 0)
+    {
+        EventLogReader reader(m_fileName);
+        if (!reader.isValid())
+        {
+            qCritical() << "Will not append to" << m_fileName;
+            return false;
+        }
+        EventRecord record;
+        while (reader.next(record))
+        {
+        }
+        valid = reader.position();
+        const auto& senders = reader.senders();
+        for (int i = 0; i < senders.count(); ++i)
+        {
+            m_senders.insert(senders[i], quint32(i));
+        }
+    }
+
+    QFile f(m_fileName);
+    if (!f.open(QFile::ReadWrite))
+    {
+        qCritical() << "Could not open" << m_fileName;
+        return false;
+    }
+    if (valid == 0)
+    {
+        f.resize(0);
+        f.write(MAGIC, MAGIC_SIZE);
+    }
+    else if (valid < f.size())
+    {
+        qWarning() << "Dropping incomplete record at the end of" << m_fileName;
+        f.resize(valid);
+    }
+    f.close();
+
+    LogService::instance().add(&m_stream);
+    m_added = true;
+    return true;
+}
+
+void EventLogWriter::append(qint64 timestamp, QStringView sender, QStringView eventId, QStringView body)
+{
+    if (!m_added)
+    {
+        return;
+    }
+
+    const QByteArray id = eventId.toUtf8();
+    if (id.size() > 0xffff)
+    {
+        // Matrix ids are far shorter than that; a truncated one would be useless anyway
+        qWarning() << "Not logging event with an id of" << id.size() << "bytes to" << m_fileName;
+        return;
+    }
+
+    m_records.clear();
+    const QString senderId = sender.toString();
+    auto it = m_senders.constFind(senderId);
+    const bool newSender = it == m_senders.constEnd();
+    if (newSender)
+    {
+        it = m_senders.insert(senderId, quint32(m_senders.count()));
+        m_payload.clear();
+        appendLittleEndian<quint32>(m_payload, it.value());
+        m_payload.append(senderId.toUtf8());
+        appendRecord(EventLog::Kind::Sender, m_payload);
+    }
+
+    m_payload.clear();
+    appendLittleEndian<qint64>(m_payload, timestamp);
+    appendLittleEndian<quint32>(m_payload, it.value());
+    appendLittleEndian<quint16>(m_payload, quint16(id.size()));
+    m_payload.append(id);
+    m_payload.append(body.toUtf8());
+    appendRecord(EventLog::Kind::Event, m_payload);
+
+    if (!LogService::instance().write(&m_stream, m_records) && newSender)
+    {
+        // The Sender record was dropped too; write it with the next event
+        m_senders.remove(senderId);
+    }
+}
+
+void EventLogWriter::appendRecord(EventLog::Kind kind, const QByteArray& payload)
+{
+    appendLittleEndian<quint32>(m_records, quint32(payload.size() + 1));
+    m_records.append(char(kind));
+    m_records.append(payload);
+}
+
+}  // namespace QuatBot
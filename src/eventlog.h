@@ -0,0 +1,133 @@
+/*
+ *  SPDX-License-Identifier: BSD-2-Clause
+ *  SPDX-License-File: LICENSE
+ *
+ * Copyright 2026 Adriaan de Groot <groot@kde.org>
+ */
+
+#ifndef QUATBOT_EVENTLOG_H
+#define QUATBOT_EVENTLOG_H
+
+#include "logservice.h"
+
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QString>
+#include <QStringView>
+#include <QVector>
+
+#include <limits>
+
+namespace QuatBot
+{
+/** @brief Binary event log
+ *
+ * The text logs are for people: they truncate sender names and
+ * line up multi-line messages. For later analysis, a log can also
+ * be written as an append-only stream of binary records, which
+ * keeps everything and needs no parsing.
+ *
+ * The file starts with the 4-byte magic `QBE1`. Each record is a
+ * 4-byte length (of the rest of the record), a 1-byte kind, and then:
+ *  - for a Sender record, a 4-byte index and the UTF-8 sender id;
+ *  - for an Event record, an 8-byte timestamp (ms since the epoch,
+ *    or noTimestamp), the 4-byte index of the sender, a 2-byte length
+ *    and the UTF-8 event id, and the UTF-8 body.
+ *
+ * Integers are little-endian. Each sender id is written once, in a
+ * Sender record before its first Event record, so the file is
+ * self-contained.
+ */
+namespace EventLog
+{
+enum class Kind : quint8
+{
+    Sender = 1,
+    Event = 2,
+};
+
+/// @brief Timestamp for events without one (messages from the bot itself)
+static constexpr const qint64 noTimestamp = std::numeric_limits<qint64>::min();
+}  // namespace EventLog
+
+/// @brief One Event record, as read by EventLogReader
+struct EventRecord
+{
+    qint64 timestamp = EventLog::noTimestamp;
+    quint32 sender = 0;  ///< Index, see EventLogReader::sender()
+    QByteArray eventId;  ///< UTF-8, refers to the mapped file
+    QByteArray body;  ///< UTF-8, refers to the mapped file
+};
+
+/** @brief Reads a binary event log
+ *
+ * The file is mapped into memory, and records are read from
+ * the mapping; the id and body of a record refer to the mapped
+ * memory, so they are only valid while the reader exists.
+ * A partially-written record at the end is ignored.
+ */
+class EventLogReader
+{
+public:
+    explicit EventLogReader(const QString& fileName);
+    ~EventLogReader();
+
+    /// @brief Is the file a (mapped) event log?
+    bool isValid() const { return m_data != nullptr; }
+
+    /// @brief Reads the next Event record; returns @c false at the end
+    bool next(EventRecord& record);
+
+    /// @brief Sender id for sender @p index (as seen so far)
+    QString sender(quint32 index) const { return m_senders.value(int(index)); }
+    /// @brief All the sender ids seen so far, by index
+    const QVector<QString>& senders() const { return m_senders; }
+
+    /// @brief Length of the file up to the end of the last complete record read
+    qint64 position() const { return m_pos; }
+
+private:
+    QFile m_file;
+    uchar* m_data = nullptr;
+    qint64 m_size = 0;
+    qint64 m_pos = 0;
+    QVector<QString> m_senders;
+};
+
+/** @brief Appends records to a binary event log
+ *
+ * Opening an existing log reads it first, to pick up the
+ * senders already in it (and to drop a partial record at the end);
+ * a file too short to hold the header is started over. The records
+ * are encoded on the calling thread, and written by the LogService.
+ * Events with an id that does not fit the record (64KiB) are not
+ * logged.
+ */
+class EventLogWriter
+{
+public:
+    /// @brief The file is synced to disk when closed if @p syncOnClose is set
+    EventLogWriter(const QString& fileName, bool syncOnClose);
+    ~EventLogWriter();
+
+    bool open();
+    void append(qint64 timestamp, QStringView sender, QStringView eventId, QStringView body);
+
+    QString fileName() const { return m_fileName; }
+    /// @brief Events dropped because the disk could not keep up
+    quint64 dropped() const { return m_stream.dropped(); }
+
+private:
+    void appendRecord(EventLog::Kind kind, const QByteArray& payload);
+
+    QString m_fileName;
+    AppendStream m_stream;
+    bool m_added = false;
+    QHash<QString, quint32> m_senders;
+    QByteArray m_records;  ///< Encoded records, re-used for each append()
+    QByteArray m_payload;  ///< Re-used for each record
+};
+
+}  // namespace QuatBot
+#endif
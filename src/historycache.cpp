@@ -0,0 +1,241 @@
+/*
+ *  SPDX-License-Identifier: BSD-2-Clause
+ *  SPDX-License-File: LICENSE
+ *
+ * Copyright 2026 Adriaan de Groot <groot@kde.org>
+ */
+
+#include "historycache.h"
+
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QtEndian>
+
+#include <algorithm>
+#include <numeric>
+
+namespace QuatBot
+{
+static constexpr const int LENGTH_SIZE = 4;
+static constexpr const QDataStream::Version STREAM_VERSION = QDataStream::Qt_5_12;
+
+/// @brief Reads one record from @p f; returns false at the end or at a partial (or bogus) record
+static bool readRecord(QFile& f, QByteArray& record)
+{
+    const QByteArray length = f.read(LENGTH_SIZE);
+    if (length.size() < LENGTH_SIZE)
+    {
+        return false;
+    }
+    // Don't believe a length that runs past the end of the file
+    const quint32 size = qFromBigEndian<quint32>(length.constData());
+    if (size > f.size() - f.pos())
+    {
+        return false;
+    }
+    record = f.read(size);
+    return record.size() == int(size);
+}
+
+HistoryCache::HistoryCache(const QString& fileName)
+    : m_file(fileName)
+{
+}
+
+bool HistoryCache::open()
+{
+    QDir().mkpath(QFileInfo(m_file.fileName()).absolutePath());
+    if (!m_file.open(QFile::ReadWrite))
+    {
+        qWarning() << "Could not open history cache" << m_file.fileName();
+        return false;
+    }
+
+    QVector<Span> kept;
+    const qint64 valid = scan(kept);
+    if (valid < m_file.size())
+    {
+        qWarning() << "Dropping incomplete page at the end of" << m_file.fileName();
+        m_file.resize(valid);
+    }
+    const qint64 keptSize = std::accumulate(
+        kept.cbegin(), kept.cend(), qint64(0), [](qint64 size, const Span& s) { return size + s.size; });
+    if (keptSize < valid && !compact(kept))
+    {
+        return false;
+    }
+    qDebug() << "History cache" << m_file.fileName() << "has" << m_tokens.count() << "pages";
+    return true;
+}
+
+qint64 HistoryCache::scan(QVector<Span>& kept)
+{
+    m_tokens.clear();
+    m_events.clear();
+    m_file.seek(0);
+
+    qint64 offset = 0;
+    QString from;
+    QString end;
+    QString id;
+    QString sender;
+    QString body;
+    while (readRecord(m_file, m_record))
+    {
+        QDataStream in(m_record);
+        in.setVersion(STREAM_VERSION);
+        qint32 count = 0;
+        in >> from >> end >> count;
+        // A page is worth keeping if it has a new token or new events (or marks the end of history)
+        bool useful = count == 0 || (!from.isEmpty() && !m_tokens.contains(from));
+        for (qint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i)
+        {
+            qint64 timestamp = 0;
+            in >> timestamp >> id >> sender >> body;
+            const quint64 hash = MessageStore::hashId(id);
+            if (!m_events.contains(hash))
+            {
+                m_events.insert(hash, offset);
+                useful = true;
+            }
+        }
+        if (useful && !from.isEmpty() && !m_tokens.contains(from))
+        {
+            m_tokens.insert(from, offset);
+        }
+        if (useful)
+        {
+            kept.append(Span { offset, m_file.pos() - offset });
+        }
+        offset = m_file.pos();
+    }
+    return offset;
+}
+
+bool HistoryCache::compact(const QVector<Span>& kept)
+{
+    QSaveFile out(m_file.fileName());
+    if (!out.open(QFile::WriteOnly))
+    {
+        qWarning() << "Could not compact history cache" << m_file.fileName();
+        return true;  // The cache is still usable as it is
+    }
+    for (const auto& s : kept)
+    {
+        m_file.seek(s.offset);
+        out.write(m_file.read(s.size));
+    }
+    if (!out.commit())
+    {
+        qWarning() << "Could not compact history cache" << m_file.fileName();
+        return true;
+    }
+
+    // The offsets in the index are different now
+    m_file.close();
+    if (!m_file.open(QFile::ReadWrite))
+    {
+        qWarning() << "Could not open history cache" << m_file.fileName();
+        return false;
+    }
+    QVector<Span> all;
+    scan(all);
+    qDebug() << "Compacted history cache" << m_file.fileName() << "to" << all.count() << "pages";
+    return true;
+}
+
+bool HistoryCache::read(qint64 offset, MessageStore& store, Page& page)
+{
+    if (m_served.contains(offset) || !m_file.seek(offset) || !readRecord(m_file, m_record))
+    {
+        return false;
+    }
+    QDataStream in(m_record);
+    in.setVersion(STREAM_VERSION);
+    qint32 count = 0;
+    in >> page.from >> page.end >> count;
+    page.messages.clear();
+    QString id;
+    QString sender;
+    QString body;
+    for (qint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i)
+    {
+        qint64 timestamp = 0;
+        in >> timestamp >> id >> sender >> body;
+        page.messages.push_back(store.add(timestamp, id, sender, body));
+    }
+    if (in.status() != QDataStream::Ok)
+    {
+        return false;
+    }
+    m_served.insert(offset);
+    ++m_hits;
+    return true;
+}
+
+bool HistoryCache::find(const QString& from, MessageStore& store, Page& page)
+{
+    const auto it = m_tokens.constFind(from);
+    return it != m_tokens.constEnd() && read(it.value(), store, page);
+}
+
+bool HistoryCache::findOverlap(const MessageData& message, MessageStore& store, Page& page)
+{
+    const auto it = m_events.constFind(message.idHash());
+    return it != m_events.constEnd() && read(it.value(), store, page);
+}
+
+void HistoryCache::add(const QString& from, const QString& end, const MessageList& messages, const MessageStore& store)
+{
+    if (!m_file.isOpen() || (!from.isEmpty() && m_tokens.contains(from)))
+    {
+        return;
+    }
+    // A page of events that are all cached already adds nothing (except at the end of history)
+    const bool cached = !messages.empty()
+        && std::all_of(messages.cbegin(),
+                       messages.cend(),
+                       [this](const MessageData& m) { return m_events.contains(m.idHash()); });
+    if (cached)
+    {
+        return;
+    }
+
+    m_record = QByteArray(LENGTH_SIZE, '\0');
+    {
+        QDataStream out(&m_record, QIODevice::WriteOnly | QIODevice::Append);
+        out.setVersion(STREAM_VERSION);
+        out << from << end << qint32(messages.size());
+        for (const auto& m : messages)
+        {
+            out << m.timestamp() << store.id(m).toString() << store.senderId(m).toString()
+                << store.plainBody(m).toString();
+        }
+    }
+    qToBigEndian<quint32>(quint32(m_record.size() - LENGTH_SIZE), m_record.data());
+
+    const qint64 offset = m_file.size();
+    m_file.seek(offset);
+    m_file.write(m_record);
+    m_file.flush();
+    ++m_misses;
+
+    // This run has the page already
+    m_served.insert(offset);
+    if (!from.isEmpty())
+    {
+        m_tokens.insert(from, offset);
+    }
+    for (const auto& m : messages)
+    {
+        if (!m_events.contains(m.idHash()))
+        {
+            m_events.insert(m.idHash(), offset);
+        }
+    }
+}
+
+}  // namespace QuatBot
@@ -0,0 +1,95 @@
+/*
+ *  SPDX-License-Identifier: BSD-2-Clause
+ *  SPDX-License-File: LICENSE
+ *
+ * Copyright 2026 Adriaan de Groot <groot@kde.org>
+ */
+
+#ifndef QUATBOT_HISTORYCACHE_H
+#define QUATBOT_HISTORYCACHE_H
+
+#include "dumpbot.h"
+
+#include <QFile>
+#include <QHash>
+#include <QSet>
+#include <QString>
+#include <QVector>
+
+namespace QuatBot
+{
+/** @brief Pages of room history fetched earlier, on disk
+ *
+ * The dumper paginates back through a room's history; each page is
+ * fetched *from* a pagination token, and ends at another token that
+ * the next page is fetched from. The cache keeps each page, so that
+ * a later run can:
+ * - serve a page starting at a known token without fetching it,
+ * - and, when a freshly fetched page reaches into history that was
+ *   fetched before (it contains a cached event id), continue with
+ *   the cached pages from there.
+ * Only the stretch of history that was not fetched before needs to
+ * be fetched again.
+ *
+ * There is one cache file per room. It is a sequence of records,
+ * each a 4-byte (big-endian) length and then a QDataStream with the
+ * from- and end-tokens and the messages of one page. Only an index
+ * (tokens and event id hashes to file offsets) is kept in memory.
+ * Pages with nothing new (all their events are in earlier pages)
+ * are not added, and dropped from the file when it is opened.
+ */
+class HistoryCache
+{
+public:
+    struct Page
+    {
+        QString from;
+        QString end;
+        MessageList messages;  ///< As fetched, so usually newest-first
+    };
+
+    explicit HistoryCache(const QString& fileName);
+
+    /// @brief Reads (and compacts) the cache file; returns @c false (with a warning) if it can't be used
+    bool open();
+
+    /// @brief Finds the page fetched from token @p from, with its text in @p store
+    bool find(const QString& from, MessageStore& store, Page& page);
+    /** @brief Finds a page holding an earlier copy of @p message
+     *
+     * Each page is returned only once (by find() or this), so
+     * that the dumper does not go around in circles.
+     */
+    bool findOverlap(const MessageData& message, MessageStore& store, Page& page);
+    /// @brief Adds a page fetched from the server, with its text in @p store, unless it adds nothing
+    void add(const QString& from, const QString& end, const MessageList& messages, const MessageStore& store);
+
+    /// @brief Pages served from the cache
+    int hits() const { return m_hits; }
+    /// @brief Pages fetched from the server and added to the cache
+    int misses() const { return m_misses; }
+
+private:
+    struct Span
+    {
+        qint64 offset;
+        qint64 size;
+    };
+
+    bool read(qint64 offset, MessageStore& store, Page& page);
+    /// @brief Builds the index; returns the end of the last complete record, with the useful ones in @p kept
+    qint64 scan(QVector<Span>& kept);
+    /// @brief Rewrites the file with only the records in @p kept; returns @c false if the cache is lost
+    bool compact(const QVector<Span>& kept);
+
+    QFile m_file;
+    QHash<QString, qint64> m_tokens;  ///< From-token to record offset
+    QHash<quint64, qint64> m_events;  ///< Event id hash to record offset
+    QSet<qint64> m_served;
+    QByteArray m_record;  ///< Re-used for each record
+    int m_hits = 0;
+    int m_misses = 0;
+};
+
+}  // namespace QuatBot
+#endif
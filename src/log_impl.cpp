@@ -9,178 +9,1184 @@
 
 // Slightly weird: non-Quotient type for logging
 #include "dumpbot.h"
+#include "eventlog.h"
+#include "logindex.h"
+#include "logpaths.h"
+#include "logreader.h"
+#include "logservice.h"
 
 #include <room.h>
 
+#include <QDateTime>
+#include <QDir>
+#include <QElapsedTimer>
 #include <QFile>
-#include <QRegularExpression>
-#include <QTextStream>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QVector>
+
+#include <atomic>
+
+#include <unistd.h>
 
 namespace QuatBot
 {
+LogSink::~LogSink() {}
+
+/** @brief The segmented file of a log, written by the LogService
+ *
+ * The log is written as a series of segments: `<base>.log`, then
+ * `<base>.1.log`, `<base>.2.log`, .. A new segment is started (by the
+ * writer thread, between two batches of entries) when the current one
+ * reaches the size or age limit of the LogRotation. The segments are listed
+ * in a manifest, `<base>.manifest.json`, which is also what allows
+ * re-opening a log to append to it rather than start over.
+ *
+ * Compressed segments (named with an additional `.z`) are written in
+ * blocks, see CompressedSegment. To get reasonable compression, text
+ * is collected into a block of BLOCK_SIZE, but a block is also
+ * written when the sink is flushed, or after the writer has been idle
+ * for BLOCK_IDLE_TIME, so that not too much is held back.
+ *
+ * Written entries are fsync()ed according to the LogDurability.
+ */
+class SegmentStream : public LogStream
+{
+    static constexpr const int BLOCK_SIZE = 64 * 1024;
+    static constexpr const int BLOCK_IDLE_TIME = 1000;  // ms
+
+public:
+    SegmentStream(const QString& base, const LogRotation& rotation, const LogDurability& durability)
+        : m_base(base)
+        , m_directory(QFileInfo(base).absolutePath())
+        , m_rotation(rotation)
+        , m_durability(durability)
+    {
+    }
+
+    /** @brief Finds the last segment, or starts a new one
+     *
+     * This happens on the calling thread, before the stream is added
+     * to the LogService, so that failure to open can be reported
+     * right away. Returns @c false on failure. Checking the blocks of
+     * a compressed segment takes a while, so that is left to the
+     * writer thread (see recover()).
+     */
+    bool open()
+    {
+        if (!QDir().mkpath(m_directory))
+        {
+            qCritical() << "Could not create log directory" << m_directory;
+            return false;
+        }
+        readManifest();
+        const bool resume = !m_segments.isEmpty() && m_segments.last().closed.isNull();
+        if (resume)
+        {
+            m_bytes = QFileInfo(QDir(m_directory).filePath(m_segments.last().file)).size();
+        }
+        if (resume && isCompressed(m_segments.last()) == m_rotation.compress && !isFull(0)
+            && openSegment(m_segments.last()))
+        {
+            m_bytes = m_file.size();
+        }
+        else
+        {
+            if (resume)
+            {
+                finishSegment();
+            }
+            if (!startSegment())
+            {
+                return false;
+            }
+        }
+
+        // The writer thread opens it again when needed
+        m_fileName = m_file.fileName();
+        m_file.close();
+        m_sinceSync.start();
+        m_sinceWake.start();
+        return true;
+    }
+
+    /// @brief File name of the segment that was current when opened
+    QString fileName() const { return m_fileName; }
+
+    LogSyncStats syncStats() const
+    {
+        return LogSyncStats { m_syncCount.load(), m_syncTime.load(), m_syncMax.load() };
+    }
+
+    void writeData(const QByteArray& data, int entries) override
+    {
+        m_sinceWake.restart();
+        if (isFull(data.size()))
+        {
+            rotate();
+        }
+        writeBatch(data);
+        m_unsynced += entries;
+        syncIfDue();
+    }
+
+    /// @brief Writes out any partial block
+    void flushRequested() override { writeBlock(); }
+
+    /// @brief How long until a partial block or a sync is due (in ms), or -1 if nothing is
+    int waitTime() const override
+    {
+        int timeout = -1;
+        if (!m_block.isEmpty())
+        {
+            timeout = int(qMax<qint64>(0, BLOCK_IDLE_TIME - m_sinceWake.elapsed()));
+        }
+        if (m_durability.policy == LogDurability::Policy::Interval && m_unsynced > 0)
+        {
+            const int untilSync = int(qMax<qint64>(0, m_durability.interval - m_sinceSync.elapsed()));
+            timeout = timeout < 0 ? untilSync : qMin(timeout, untilSync);
+        }
+        return timeout;
+    }
+
+    void idle() override
+    {
+        if (!m_block.isEmpty() && m_sinceWake.elapsed() >= BLOCK_IDLE_TIME)
+        {
+            writeBlock();
+        }
+        syncIfDue();
+    }
+
+    void suspend() override { m_file.close(); }
+
+    void finish() override
+    {
+        writeBlock();
+        if (m_durability.policy != LogDurability::Policy::None && m_unsynced > 0)
+        {
+            sync();
+        }
+        // The segment is not finished: re-opening the log appends to it
+        m_file.close();
+    }
+
+private:
+    struct Segment
+    {
+        QString file;  ///< Name within the log directory
+        QDateTime opened;
+        QDateTime closed;  ///< Null until the log moves on to the next segment
+        qint64 bytes = 0;
+    };
+
+    void syncIfDue()
+    {
+        if (m_unsynced <= 0)
+        {
+            return;
+        }
+        switch (m_durability.policy)
+        {
+        case LogDurability::Policy::None:
+        case LogDurability::Policy::Close:
+            return;
+        case LogDurability::Policy::Records:
+            if (m_unsynced >= m_durability.records)
+            {
+                sync();
+            }
+            return;
+        case LogDurability::Policy::Interval:
+            if (m_sinceSync.elapsed() >= m_durability.interval)
+            {
+                sync();
+            }
+            return;
+        }
+    }
+
+    /** @brief Gets everything written so far onto the disk
+     *
+     * This is the group commit: one fsync() covers all the entries
+     * written since the previous one (including those collected
+     * for a compressed block, which is written first).
+     */
+    void sync()
+    {
+        writeBlock();
+        if (reopen())
+        {
+            QElapsedTimer t;
+            t.start();
+            m_file.flush();
+            if (::fsync(m_file.handle()) != 0)
+            {
+                qWarning() << "Could not sync" << m_file.fileName();
+            }
+            const qint64 us = t.nsecsElapsed() / 1000;
+            m_syncCount.fetch_add(1);
+            m_syncTime.fetch_add(us);
+            if (us > m_syncMax.load())
+            {
+                m_syncMax.store(us);
+            }
+        }
+        m_unsynced = 0;
+        m_sinceSync.restart();
+    }
+
+    /** @brief Drops a partially-written block at the end of the current (closed) segment
+     *
+     * This reads the whole segment, so it runs on the writer thread,
+     * before anything is appended to a segment that was resumed.
+     */
+    void recover()
+    {
+        m_recover = false;
+        QFile f(m_file.fileName());
+        if (!f.open(QFile::ReadWrite))
+        {
+            return;
+        }
+        const qint64 valid = CompressedSegment::validLength(f);
+        if (valid >= 0 && valid < f.size())
+        {
+            qWarning() << "Dropping incomplete block at the end of" << f.fileName();
+            m_bytes -= f.size() - valid;
+            f.resize(valid);
+        }
+    }
+
+    /// @brief Makes sure the current segment is open, after a suspend()
+    bool reopen()
+    {
+        if (m_file.isOpen())
+        {
+            return true;
+        }
+        if (m_recover)
+        {
+            recover();
+        }
+        if (m_file.fileName().isEmpty() || !m_file.open(QFile::WriteOnly | QFile::Append))
+        {
+            qWarning() << "Could not re-open" << m_file.fileName();
+            return false;
+        }
+        return true;
+    }
+
+    void writeBatch(const QByteArray& batch)
+    {
+        if (m_rotation.compress)
+        {
+            m_block.append(batch);
+            if (m_block.size() >= BLOCK_SIZE)
+            {
+                writeBlock();
+            }
+        }
+        else if (!batch.isEmpty() && reopen())
+        {
+            m_file.write(batch);
+            m_file.flush();
+            m_bytes += batch.size();
+        }
+    }
+
+    /// @brief Compresses and writes the collected text, if any
+    void writeBlock()
+    {
+        if (!m_block.isEmpty() && reopen())
+        {
+            const QByteArray block = CompressedSegment::block(m_block);
+            m_file.write(block);
+            m_file.flush();
+            m_bytes += block.size();
+        }
+        m_block.clear();
+    }
+
+    /** @brief Should the current segment be closed before writing @p pending more bytes?
+     *
+     * An empty segment is never full, so that an entry larger than
+     * the size limit still gets written.
+     */
+    bool isFull(qint64 pending) const
+    {
+        // Uncompressed text counts fully, but only until it is compressed
+        const qint64 size = m_bytes + m_block.size() + pending;
+        if (size <= 0 || m_segments.isEmpty())
+        {
+            return false;
+        }
+        if (m_rotation.maxBytes > 0 && size > m_rotation.maxBytes)
+        {
+            return true;
+        }
+        return m_rotation.maxSeconds > 0
+            && m_segments.last().opened.secsTo(QDateTime::currentDateTimeUtc()) >= m_rotation.maxSeconds;
+    }
+
+    QString segmentName(int index) const
+    {
+        const QString base = QFileInfo(m_base).fileName();
+        const QString name = index > 0 ? QString("%1.%2.log").arg(base).arg(index) : QString("%1.log").arg(base);
+        return m_rotation.compress ? name + QLatin1String(CompressedSegment::suffix) : name;
+    }
+
+    static bool isCompressed(const Segment& segment)
+    {
+        return segment.file.endsWith(QLatin1String(CompressedSegment::suffix));
+    }
+
+    QString manifestName() const { return m_base + QStringLiteral(".manifest.json"); }
+
+    /** @brief Opens @p segment for appending
+     *
+     * This never truncates, except that a partially-written block at
+     * the end of a compressed segment is dropped (later, see recover()),
+     * so that the blocks written next can be read back.
+     */
+    bool openSegment(const Segment& segment)
+    {
+        m_file.setFileName(QDir(m_directory).filePath(segment.file));
+        if (isCompressed(segment) && m_file.open(QFile::ReadWrite))
+        {
+            if (m_file.size() == 0)
+            {
+                m_file.write(CompressedSegment::header());
+            }
+            else if (m_file.read(CompressedSegment::header().size()) != CompressedSegment::header())
+            {
+                qCritical() << "Not a compressed log segment" << m_file.fileName();
+                m_file.close();
+                return false;
+            }
+            else
+            {
+                // reopen() recovers it first
+                m_recover = true;
+                m_file.close();
+                return true;
+            }
+            m_file.seek(m_file.size());
+            return true;
+        }
+        if (!m_file.open(QFile::WriteOnly | QFile::Append))
+        {
+            qCritical() << "Could not open" << m_file.fileName();
+            return false;
+        }
+        return true;
+    }
+
+    bool startSegment()
+    {
+        Segment segment;
+        segment.file = segmentName(m_nextIndex++);
+        segment.opened = QDateTime::currentDateTimeUtc();
+        if (!openSegment(segment))
+        {
+            return false;
+        }
+        // A segment left over without a manifest is appended to, not clobbered
+        m_bytes = m_file.size();
+        m_segments.append(segment);
+        prune();
+        writeManifest();
+        return true;
+    }
+
+    void finishSegment()
+    {
+        if (m_recover)
+        {
+            recover();
+        }
+        if (m_durability.policy != LogDurability::Policy::None && m_unsynced > 0)
+        {
+            sync();
+        }
+        if (m_file.isOpen())
+        {
+            m_file.close();
+        }
+        if (!m_segments.isEmpty())
+        {
+            m_segments.last().closed = QDateTime::currentDateTimeUtc();
+            m_segments.last().bytes = m_bytes;
+        }
+        m_bytes = 0;
+    }
+
+    void rotate()
+    {
+        writeBlock();
+        finishSegment();
+        if (startSegment())
+        {
+            qDebug() << "Log continues in" << m_file.fileName();
+        }
+    }
+
+    /// @brief Removes the oldest (closed) segments beyond the limit
+    void prune()
+    {
+        if (m_rotation.keepSegments <= 0)
+        {
+            return;
+        }
+        while (m_segments.count() > m_rotation.keepSegments && !m_segments.first().closed.isNull())
+        {
+            QFile::remove(QDir(m_directory).filePath(m_segments.first().file));
+            m_segments.removeFirst();
+        }
+    }
+
+    void readManifest()
+    {
+        m_segments.clear();
+        m_nextIndex = 0;
+
+        QFile f(manifestName());
+        if (!f.open(QFile::ReadOnly))
+        {
+            return;
+        }
+        const QJsonObject manifest = QJsonDocument::fromJson(f.readAll()).object();
+        for (const auto& v : manifest.value(QStringLiteral("segments")).toArray())
+        {
+            const QJsonObject o = v.toObject();
+            Segment segment;
+            segment.file = o.value(QStringLiteral("file")).toString();
+            segment.opened = QDateTime::fromString(o.value(QStringLiteral("opened")).toString(), Qt::ISODate);
+            segment.closed = QDateTime::fromString(o.value(QStringLiteral("closed")).toString(), Qt::ISODate);
+            segment.bytes = o.value(QStringLiteral("bytes")).toVariant().toLongLong();
+            if (!segment.file.isEmpty())
+            {
+                m_segments.append(segment);
+            }
+        }
+        m_nextIndex = manifest.value(QStringLiteral("next")).toInt(m_segments.count());
+    }
+
+    void writeManifest() const
+    {
+        QJsonArray segments;
+        for (const auto& segment : m_segments)
+        {
+            QJsonObject o { { QStringLiteral("file"), segment.file },
+                            { QStringLiteral("opened"), segment.opened.toString(Qt::ISODate) } };
+            if (!segment.closed.isNull())
+            {
+                o.insert(QStringLiteral("closed"), segment.closed.toString(Qt::ISODate));
+                o.insert(QStringLiteral("bytes"), segment.bytes);
+            }
+            segments.append(o);
+        }
+
+        QSaveFile f(manifestName());
+        if (!f.open(QFile::WriteOnly))
+        {
+            qWarning() << "Could not write log manifest" << f.fileName();
+            return;
+        }
+        f.write(QJsonDocument(QJsonObject { { QStringLiteral("segments"), segments },
+                                            { QStringLiteral("next"), m_nextIndex } })
+                    .toJson());
+        f.commit();
+    }
+
+    const QString m_base;
+    const QString m_directory;
+    const LogRotation m_rotation;
+    const LogDurability m_durability;
+
+    QString m_fileName;
+
+    // These belong to the writer thread once the stream is added to the service
+    QFile m_file;
+    qint64 m_bytes = 0;  ///< Size of the current segment
+    QVector<Segment> m_segments;
+    int m_nextIndex = 0;
+    QByteArray m_block;  ///< Text for the next compressed block
+    bool m_recover = false;  ///< The current segment may end in a partial block, see recover()
+    int m_unsynced = 0;  ///< Entries written since the last sync
+    QElapsedTimer m_sinceSync;
+    QElapsedTimer m_sinceWake;
+
+    std::atomic<quint64> m_syncCount { 0 };
+    std::atomic<qint64> m_syncTime { 0 };  // microseconds
+    std::atomic<qint64> m_syncMax { 0 };
+};
+
+/** @brief Sink writing to a segmented file, through the LogService
+ *
+ * The entries are handed to the service, whose writer threads
+ * write whatever has accumulated in one go; a slow disk then
+ * only delays those threads, not the bot. Destroying the sink
+ * waits until all the pending entries are written.
+ */
+class FileSink : public LogSink
+{
+public:
+    FileSink(const QString& base, const LogRotation& rotation, const LogDurability& durability)
+        : m_stream(base, rotation, durability)
+    {
+    }
+
+    ~FileSink() override
+    {
+        if (m_added)
+        {
+            LogService::instance().remove(&m_stream);
+        }
+    }
+
+    /// @brief Opens the file (see SegmentStream::open()); returns @c false on failure
+    bool open()
+    {
+        if (!m_stream.open())
+        {
+            return false;
+        }
+        LogService::instance().add(&m_stream);
+        m_added = true;
+        return true;
+    }
+
+    QString fileName() const { return m_stream.fileName(); }
+
+    void write(const LogEntry& entry) override { LogService::instance().write(&m_stream, entry.text.toUtf8()); }
+    void flush() override { LogService::instance().flush(&m_stream); }
+    LogSyncStats syncStats() const override { return m_stream.syncStats(); }
+    quint64 dropped() const override { return m_stream.dropped(); }
+
+private:
+    SegmentStream m_stream;
+    bool m_added = false;
+};
+
+/** @brief Sink writing binary event records
+ *
+ * Records are only synced when the log is closed (unless the
+ * durability policy is None).
+ */
+class EventSink : public LogSink
+{
+public:
+    EventSink(const QString& fileName, const LogDurability& durability)
+        : m_writer(fileName, durability.policy != LogDurability::Policy::None)
+    {
+    }
+
+    bool open() { return m_writer.open(); }
+
+    void write(const LogEntry& entry) override
+    {
+        m_writer.append(entry.timestamp.isValid() ? entry.timestamp.toMSecsSinceEpoch() : EventLog::noTimestamp,
+                        entry.sender,
+                        entry.eventId,
+                        entry.message);
+    }
+
+    quint64 dropped() const override { return m_writer.dropped(); }
+
+private:
+    EventLogWriter m_writer;
+};
+
+/// @brief Sink adding entries to the search index
+class IndexSink : public LogSink
+{
+public:
+    explicit IndexSink(const QString& fileName)
+        : m_writer(fileName)
+    {
+    }
+
+    bool open() { return m_writer.open(); }
+
+    void write(const LogEntry& entry) override { m_writer.add(entry.timestamp, entry.sender, entry.message); }
+    quint64 dropped() const override { return m_writer.dropped(); }
+
+private:
+    LogIndexWriter m_writer;
+};
+
+/// @brief Sink echoing to qDebug(), as the bot has always done
+class ConsoleSink : public LogSink
+{
+public:
+    void write(const LogEntry& entry) override
+    {
+        // Without the trailing newline, qDebug() adds its own
+        qDebug().noquote().nospace() << entry.text.chopped(1);
+    }
+};
+
+/// @brief Sink discarding everything
+class NullSink : public LogSink
+{
+public:
+    void write(const LogEntry&) override {}
+};
+
+/** @brief Sink writing one JSON object per entry to standard output
+ *
+ * The objects have the keys *log* (the name of the log file, if any),
+ * *ts* (milliseconds since the epoch, absent for the bot's own messages),
+ * *sender* and *body*; the sender and body are not truncated or
+ * padded. Each object is written with a single unbuffered write,
+ * so that lines from different threads do not get mixed up.
+ */
+class JsonSink : public LogSink
+{
+public:
+    /// @brief The @p logName is referred to, not copied, so it follows the log being opened and closed
+    explicit JsonSink(const QString& logName)
+        : m_logName(logName)
+    {
+        if (!m_out.open(1, QIODevice::WriteOnly | QIODevice::Unbuffered, QFile::DontCloseHandle))
+        {
+            qWarning() << "Could not open standard output for JSON logging.";
+        }
+    }
+
+    void write(const LogEntry& entry) override
+    {
+        if (!m_out.isOpen())
+        {
+            return;
+        }
+        QJsonObject o { { QStringLiteral("sender"), entry.sender.toString() },
+                        { QStringLiteral("body"), entry.message.toString() } };
+        if (!m_logName.isEmpty())
+        {
+            o.insert(QStringLiteral("log"), m_logName);
+        }
+        if (entry.timestamp.isValid())
+        {
+            o.insert(QStringLiteral("ts"), entry.timestamp.toMSecsSinceEpoch());
+        }
+        QByteArray line = QJsonDocument(o).toJson(QJsonDocument::Compact);
+        line.append('\n');
+        m_out.write(line);
+    }
+
+private:
+    const QString& m_logName;
+    QFile m_out;
+};
+
+/// @brief Sinks for logs created from now on; set once at startup
+static LoggerFile::Sinks s_defaultSinks
+    = LoggerFile::Sink::File | LoggerFile::Sink::Console | LoggerFile::Sink::Index;
+
+void LoggerFile::setDefaultSinks(Sinks sinks)
+{
+    s_defaultSinks = sinks;
+}
+
+LoggerFile::Sinks LoggerFile::defaultSinks()
+{
+    return s_defaultSinks;
+}
+
+LoggerFile::Sinks LoggerFile::parseSinks(const QString& names, bool* ok)
+{
+    Sinks sinks;
+    bool valid = true;
+    for (const auto& name : names.split(',', Qt::SkipEmptyParts))
+    {
+        const QString n = name.trimmed().toLower();
+        if (n == QStringLiteral("file"))
+        {
+            sinks |= Sink::File;
+        }
+        else if (n == QStringLiteral("console"))
+        {
+            sinks |= Sink::Console;
+        }
+        else if (n == QStringLiteral("json"))
+        {
+            sinks |= Sink::Json;
+        }
+        else if (n == QStringLiteral("events"))
+        {
+            sinks |= Sink::Events;
+        }
+        else if (n == QStringLiteral("index"))
+        {
+            sinks |= Sink::Index;
+        }
+        else if (n != QStringLiteral("none"))
+        {
+            qWarning() << "Unknown log sink" << name;
+            valid = false;
+        }
+    }
+    if (ok)
+    {
+        *ok = valid;
+    }
+    return sinks;
+}
+
+/// @brief How logs rotate and sync; set once at startup
+static LogRotation s_rotation;
+static LogDurability s_durability;
+
+void LoggerFile::setRotation(const LogRotation& rotation)
+{
+    s_rotation = rotation;
+}
+
+LogRotation LoggerFile::rotation()
+{
+    return s_rotation;
+}
+
+void LoggerFile::setDurability(const LogDurability& durability)
+{
+    s_durability = durability;
+}
+
+LogDurability LoggerFile::durability()
+{
+    return s_durability;
+}
+
+bool LoggerFile::parseDurability(const QString& policy, LogDurability& durability)
+{
+    const QString p = policy.trimmed().toLower();
+    const int colon = p.indexOf(':');
+    const QString name = colon < 0 ? p : p.left(colon);
+    bool ok = true;
+    const int value = colon < 0 ? 0 : p.mid(colon + 1).toInt(&ok);
+
+    if (name == QStringLiteral("none") && colon < 0)
+    {
+        durability.policy = LogDurability::Policy::None;
+    }
+    else if (name == QStringLiteral("close") && colon < 0)
+    {
+        durability.policy = LogDurability::Policy::Close;
+    }
+    else if (name == QStringLiteral("interval") && ok && value > 0)
+    {
+        durability.policy = LogDurability::Policy::Interval;
+        durability.interval = value;
+    }
+    else if (name == QStringLiteral("every") && ok && value > 0)
+    {
+        durability.policy = LogDurability::Policy::Records;
+        durability.records = value;
+    }
+    else
+    {
+        qWarning() << "Unknown log sync policy" << policy;
+        return false;
+    }
+    return true;
+}
+
+LogSyncStats LoggerFile::syncStats() const
+{
+    return m_fileSink ? m_fileSink->syncStats() : LogSyncStats {};
+}
+
+quint64 LoggerFile::dropped() const
+{
+    quint64 count = 0;
+    for (const LogSink* sink : { m_fileSink, m_eventSink, m_indexSink })
+    {
+        count += sink ? sink->dropped() : 0;
+    }
+    return count;
+}
+
 LoggerFile::LoggerFile()
     : m_lines(0)
 {
+    setSinks(defaultSinks());
 }
 
 LoggerFile::~LoggerFile()
 {
     close();
+    qDeleteAll(m_otherSinks);
 }
 
-void LoggerFile::close()
+void LoggerFile::setSinks(Sinks sinks)
 {
-    if (m_stream)
+    m_sinks = sinks;
+    qDeleteAll(m_otherSinks);
+    m_otherSinks.clear();
+    if (sinks.testFlag(Sink::Console))
+    {
+        m_otherSinks.append(new ConsoleSink);
+    }
+    if (sinks.testFlag(Sink::Json))
     {
-        delete m_stream;
-        m_stream = nullptr;
+        m_otherSinks.append(new JsonSink(m_fileName));
     }
-    if (m_file)
+}
+
+void LoggerFile::close()
+{
+    if (m_fileSink)
     {
-        m_file->close();
-        delete m_file;
-        m_file = nullptr;
+        delete m_fileSink;
+        m_fileSink = nullptr;
     }
+    delete m_eventSink;
+    m_eventSink = nullptr;
+    delete m_indexSink;
+    m_indexSink = nullptr;
+    m_fileName.clear();
     m_lines = -1;
 }
 
 void LoggerFile::open(const QString& name)
 {
     close();
-
-    QFile* f = new QFile(makeName(name));
-    if (!f)
+    if (!LogPaths::claim(m_room, name))
     {
-        qCritical() << "Could not allocate QFile" << name;
         return;
     }
-    if (!f->open(QFile::WriteOnly))
+    const QString base = LogPaths::resolve(name);
+
+    if (m_sinks.testFlag(Sink::Events))
     {
-        qCritical() << "Could not open" << f->fileName();
-        delete f;
-        return;
+        auto* sink = new EventSink(base + QStringLiteral(".events"), durability());
+        if (sink->open())
+        {
+            m_eventSink = sink;
+        }
+        else
+        {
+            delete sink;
+        }
+    }
+    // Only the meeting notes (see Meeting) are searched, so other logs need no index
+    if (m_sinks.testFlag(Sink::Index) && name.startsWith(QStringLiteral("notes_")))
+    {
+        auto* sink = new IndexSink(base + QStringLiteral(".index"));
+        if (sink->open())
+        {
+            m_indexSink = sink;
+        }
+        else
+        {
+            delete sink;
+        }
     }
 
-    m_file = f;
+    if (!m_sinks.testFlag(Sink::File))
+    {
+        m_fileName = base;
+        // No text file, but the log is open for the other sinks
+        m_fileSink = new NullSink;
+        m_lines = 0;
+        qDebug() << "Logging (without file) as" << m_fileName;
+        return;
+    }
 
-    QTextStream* t = new QTextStream(m_file);
-    if (!t)
+    FileSink* sink = new FileSink(base, rotation(), durability());
+    if (!sink->open())
     {
-        qCritical() << "Could not allocate QTextStream for" << name;
+        delete sink;
         close();
         return;
     }
-    m_stream = t;
+
+    m_fileName = sink->fileName();
+    m_fileSink = sink;
     m_lines = 0;
 
-    qDebug() << "Logging to" << m_file->fileName();
+    qDebug() << "Logging to" << m_fileName;
 }
 
 void LoggerFile::flush()
 {
-    if (m_stream)
+    if (m_fileSink)
+    {
+        m_fileSink->flush();
+    }
+    if (m_eventSink)
     {
-        m_stream->flush();
+        m_eventSink->flush();
     }
-    if (m_file)
+    for (auto* sink : m_otherSinks)
     {
-        m_file->flush();
+        sink->flush();
     }
 }
 
-template <class stream>
-void eol(stream& s)
+/// @brief Appends @p s (Qt 5 has no QString::append(QStringView))
+static void append(QString& buffer, QStringView s)
 {
-    s << '\n';
+    buffer.append(s.data(), int(s.size()));
 }
-template <>
-void eol<QDebug>(QDebug&)
+
+/// @brief Appends @p count spaces
+static void appendSpaces(QString& buffer, int count)
 {
+    for (int i = 0; i < count; ++i)
+    {
+        buffer.append(' ');
+    }
 }
 
-// make copies because we'll be modifying them
-template <class stream>
-void logX(stream& s, QString timestamp, QString sender, QString message)
+/// @brief Appends @p value as exactly two digits
+static void appendTwoDigits(QString& buffer, int value)
 {
-    timestamp.truncate(19);
-    if (sender.contains(':'))
-        sender.truncate(sender.indexOf(':'));
-    sender.truncate(12);
+    buffer.append(QChar('0' + (value / 10) % 10));
+    buffer.append(QChar('0' + value % 10));
+}
 
-    // Just the HH:mm:ss
-    s << timestamp.right(8).leftJustified(8) << ' ' << sender.leftJustified(12) << '\t';
-    if (message.contains('\n'))
+/** @brief Formats one log entry into @p buffer
+ *
+ * The entry is the time as HH:mm:ss (in the timezone of @p timestamp,
+ * or blank if it is invalid), the @p sender cut off at the ':' of
+ * the server part and truncated to 12 characters, and then the
+ * @p message. Continuation lines of a multi-line message are indented
+ * to line up. Each line ends with a newline.
+ *
+ * The buffer is cleared first, but keeps its capacity, so that
+ * formatting into the same buffer again doesn't allocate.
+ */
+static void formatEntry(QString& buffer, const QDateTime& timestamp, QStringView sender, QStringView message)
+{
+    static constexpr const int timeWidth = 8;  // HH:mm:ss
+    static constexpr const int senderWidth = 12;
+
+    buffer.clear();
+
+    if (timestamp.isValid())
     {
-        QStringList parts = message.split('\n');
-        bool first = true;
-        for (const auto& p : parts)
+        constexpr const qint64 secondsPerDay = 24 * 60 * 60;
+        qint64 seconds = (timestamp.toSecsSinceEpoch() + timestamp.offsetFromUtc()) % secondsPerDay;
+        if (seconds < 0)
         {
-            if (!first)
-            {
-                // 8, space, 12, tab
-                s << "        " << ' ' << "            " << '\t';
-            }
-            first = false;
-            s << p << '\n';
+            seconds += secondsPerDay;
         }
+        const int secondOfDay = int(seconds);
+        appendTwoDigits(buffer, secondOfDay / 3600);
+        buffer.append(':');
+        appendTwoDigits(buffer, (secondOfDay / 60) % 60);
+        buffer.append(':');
+        appendTwoDigits(buffer, secondOfDay % 60);
     }
     else
     {
-        s << message;
-        eol(s);
+        appendSpaces(buffer, timeWidth);
+    }
+    buffer.append(' ');
+
+    const auto colon = sender.indexOf(':');
+    if (colon >= 0)
+    {
+        sender = sender.left(colon);
+    }
+    sender = sender.left(senderWidth);
+    append(buffer, sender);
+    appendSpaces(buffer, senderWidth - int(sender.size()));
+    buffer.append('\t');
+
+    decltype(message.size()) lineStart = 0;
+    while (true)
+    {
+        const auto lineEnd = message.indexOf('\n', lineStart);
+        if (lineEnd < 0)
+        {
+            append(buffer, message.mid(lineStart));
+            buffer.append('\n');
+            break;
+        }
+        append(buffer, message.mid(lineStart, lineEnd - lineStart));
+        buffer.append('\n');
+        appendSpaces(buffer, timeWidth + 1 + senderWidth);
+        buffer.append('\t');
+        lineStart = lineEnd + 1;
     }
 }
 
-void LoggerFile::log(const QString& s)
+void LoggerFile::write(const QDateTime& timestamp, QStringView sender, QStringView eventId, QStringView message)
 {
-    if (m_stream)
+    if (!m_fileSink && m_otherSinks.isEmpty())
+    {
+        return;
+    }
+
+    formatEntry(m_buffer, timestamp, sender, message);
+    const LogEntry entry { timestamp, sender, eventId, message, m_buffer };
+
+    if (m_fileSink)
     {
         ++m_lines;
-        logX(*m_stream, QString(), QStringLiteral("*BOT*"), s);
+        m_fileSink->write(entry);
+    }
+    if (m_eventSink)
+    {
+        m_eventSink->write(entry);
     }
+    if (m_indexSink)
+    {
+        m_indexSink->write(entry);
+    }
+    for (auto* sink : m_otherSinks)
+    {
+        sink->write(entry);
+    }
+}
 
-    auto d = qDebug().noquote().nospace();
-    logX(d, QString(), QStringLiteral("*BOT*"), s);
+void LoggerFile::log(const QString& s)
+{
+    write(QDateTime(), u"*BOT*", QStringView(), s);
 }
 
 void LoggerFile::log(const QMatrixClient::RoomMessageEvent* message)
 {
-    if (m_stream)
+    write(message->originTimestamp(), message->senderId(), message->id(), message->plainBody());
+}
+
+void LoggerFile::log(const MessageStore& store, const MessageData& message)
+{
+    write(message.originTimestamp(), store.senderId(message), store.id(message), store.plainBody(message));
+}
+
+LogOptions::LogOptions()
+    : m_sinks(QStringList { "log-sinks" },
+              "Where log entries go: file, console, json, events, index or none "
+              "(default 'file,console,index').",
+              "sinks")
+    , m_directory(QStringList { "log-dir" }, "Directory for log files (default '/tmp').", "dir")
+    , m_shardLevels(QStringList { "log-shard-levels" },
+                    "Spread log files over this many levels of subdirectories (0-2, default 0).",
+                    "levels")
+    , m_maxPerRoom(QStringList { "log-max-per-room" },
+                   "Each room may open at most this many different logs (default 0, no limit).",
+                   "count")
+    , m_segmentSize(QStringList { "log-segment-size" },
+                    "Start a new log segment after this many KiB (default 65536, 0 for no limit).",
+                    "KiB")
+    , m_segmentTime(QStringList { "log-segment-time" },
+                    "Start a new log segment after this many minutes (default 0, no limit).",
+                    "minutes")
+    , m_keep(QStringList { "log-keep" }, "Keep at most this many segments of each log (default 0, all).", "count")
+    , m_compress(QStringList { "log-compress" }, "Write compressed log segments.")
+    , m_sync(QStringList { "log-sync" },
+             "When to sync logs to disk: none, close, interval:<ms> or every:<count> entries (default none).",
+             "policy")
+    , m_threads(QStringList { "log-threads" }, "Number of threads writing logs (default 2).", "count")
+    , m_maxOpen(QStringList { "log-max-open" }, "Keep at most this many log files open (default 64).", "count")
+{
+}
+
+void LogOptions::addTo(QCommandLineParser& parser) const
+{
+    parser.addOption(m_sinks);
+    parser.addOption(m_directory);
+    parser.addOption(m_shardLevels);
+    parser.addOption(m_maxPerRoom);
+    parser.addOption(m_segmentSize);
+    parser.addOption(m_segmentTime);
+    parser.addOption(m_keep);
+    parser.addOption(m_compress);
+    parser.addOption(m_sync);
+    parser.addOption(m_threads);
+    parser.addOption(m_maxOpen);
+}
+
+/// @brief Reads a non-negative number from option @p o into @p value
+static bool applyNumber(const QCommandLineParser& parser, const QCommandLineOption& o, qint64& value)
+{
+    if (!parser.isSet(o))
     {
-        ++m_lines;
-        logX(*m_stream,
-             message->originTimestamp().toString(Qt::DateFormat::ISODate),
-             message->senderId(),
-             message->plainBody());
+        return true;
     }
-
-    auto d = qDebug().noquote().nospace();
-    logX(d, message->originTimestamp().toString(Qt::DateFormat::ISODate), message->senderId(), message->plainBody());
+    bool ok = false;
+    const qint64 v = parser.value(o).toLongLong(&ok);
+    if (!ok || v < 0)
+    {
+        qWarning() << "Invalid value" << parser.value(o) << "for option" << o.names().constFirst();
+        return false;
+    }
+    value = v;
+    return true;
 }
 
-void LoggerFile::log(const QuatBot::MessageData& message)
+bool LogOptions::apply(const QCommandLineParser& parser) const
 {
-    if (m_stream)
+    if (parser.isSet(m_sinks))
     {
-        ++m_lines;
-        logX(*m_stream,
-             message.originTimestamp().toString(Qt::DateFormat::ISODate),
-             message.senderId(),
-             message.plainBody());
+        bool ok = false;
+        const auto sinks = LoggerFile::parseSinks(parser.value(m_sinks), &ok);
+        if (!ok)
+        {
+            return false;
+        }
+        LoggerFile::setDefaultSinks(sinks);
+    }
+    if (parser.isSet(m_directory))
+    {
+        LogPaths::setRoot(parser.value(m_directory));
     }
+    qint64 shardLevels = LogPaths::shardLevels();
+    qint64 maxPerRoom = 0;
+    if (!applyNumber(parser, m_shardLevels, shardLevels) || !applyNumber(parser, m_maxPerRoom, maxPerRoom))
+    {
+        return false;
+    }
+    if (shardLevels > 2)
+    {
+        qWarning() << "Invalid value" << shardLevels << "for option log-shard-levels";
+        return false;
+    }
+    LogPaths::setShardLevels(int(shardLevels));
+    LogPaths::setMaxLogsPerRoom(int(maxPerRoom));
 
-    auto d = qDebug().noquote().nospace();
-    logX(d, message.originTimestamp().toString(Qt::DateFormat::ISODate), message.senderId(), message.plainBody());
-}
+    LogRotation rotation = LoggerFile::rotation();
+    qint64 kib = rotation.maxBytes / 1024;
+    qint64 minutes = rotation.maxSeconds / 60;
+    qint64 keep = rotation.keepSegments;
+    if (!applyNumber(parser, m_segmentSize, kib) || !applyNumber(parser, m_segmentTime, minutes)
+        || !applyNumber(parser, m_keep, keep))
+    {
+        return false;
+    }
+    rotation.maxBytes = kib * 1024;
+    rotation.maxSeconds = minutes * 60;
+    rotation.keepSegments = int(keep);
+    rotation.compress = rotation.compress || parser.isSet(m_compress);
+    LoggerFile::setRotation(rotation);
 
+    if (parser.isSet(m_sync))
+    {
+        LogDurability durability = LoggerFile::durability();
+        if (!LoggerFile::parseDurability(parser.value(m_sync), durability))
+        {
+            return false;
+        }
+        LoggerFile::setDurability(durability);
+    }
 
-QString LoggerFile::makeName(QString s)
-{
-    if (s.isEmpty())
+    qint64 threads = 2;
+    qint64 maxOpen = 64;
+    if (!applyNumber(parser, m_threads, threads) || !applyNumber(parser, m_maxOpen, maxOpen))
     {
-        return QString("/tmp/quatbot.log");
+        return false;
     }
-    return QString("/tmp/quatbot-%1.log").arg(s.remove(QRegularExpression("[^a-zA-Z0-9_]")));
+    LogService::setThreads(int(threads));
+    LogService::setMaxOpenFiles(int(maxOpen));
+    return true;
 }
 
 }  // namespace QuatBot
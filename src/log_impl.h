@@ -10,39 +10,233 @@
 
 #include <room.h>
 
-#include <QFile>
+#include <QCommandLineOption>
+#include <QCommandLineParser>
+#include <QDateTime>
+#include <QFlags>
+#include <QList>
 #include <QString>
 #include <QStringList>
-#include <QTextStream>
+#include <QStringView>
 
 namespace QuatBot
 {
 
 class MessageData;
+class MessageStore;
 
+/** @brief One log entry, as handed to the sinks
+ *
+ * The entry is formatted only once, into @c text (one or more
+ * lines, each ending with a newline); sinks that want the
+ * individual fields can use the others.
+ */
+struct LogEntry
+{
+    const QDateTime& timestamp;  ///< May be invalid, for messages from the bot itself
+    QStringView sender;
+    QStringView eventId;  ///< Empty for messages from the bot itself
+    QStringView message;
+    QStringView text;  ///< The formatted entry
+};
+
+/// @brief How often, and how long, a log was synced to disk
+struct LogSyncStats
+{
+    quint64 count = 0;
+    qint64 totalTime = 0;  ///< microseconds
+    qint64 maxTime = 0;  ///< microseconds
+
+    qint64 averageTime() const { return count > 0 ? totalTime / qint64(count) : 0; }
+};
+
+/** @brief Destination for log entries
+ *
+ * A LoggerFile passes each entry to all of its sinks.
+ */
+class LogSink
+{
+public:
+    virtual ~LogSink();
+
+    virtual void write(const LogEntry& entry) = 0;
+    /// @brief Gets written entries out of any buffers (does not wait)
+    virtual void flush() {}
+    /// @brief Syncs done so far, for sinks that sync to disk
+    virtual LogSyncStats syncStats() const { return LogSyncStats {}; }
+    /// @brief Entries dropped because the disk could not keep up
+    virtual quint64 dropped() const { return 0; }
+};
+
+/** @brief When a log moves on to a new segment, how many to keep, and their format
+ *
+ * See LoggerFile::open(). A limit of 0 means no limit.
+ */
+struct LogRotation
+{
+    qint64 maxBytes = 64 * 1024 * 1024;  ///< Size of a segment (on disk)
+    qint64 maxSeconds = 0;  ///< Age of a segment
+    int keepSegments = 0;  ///< Older segments are removed
+    bool compress = false;  ///< Write compressed segments, see CompressedSegment
+};
+
+/** @brief When a log is synced (with fsync()) to disk
+ *
+ * Flushing a log only hands the entries to the operating system,
+ * which does not survive a crash of the machine. Syncing does, but
+ * costs time. Syncs are done by the writer thread, and one sync
+ * covers all the entries written since the previous one.
+ */
+struct LogDurability
+{
+    enum class Policy
+    {
+        None,  ///< Never sync
+        Close,  ///< Sync when a segment or the log is closed
+        Interval,  ///< Also sync at most @c interval ms after an entry is written
+        Records,  ///< Also sync once @c records entries are written
+    };
+    Policy policy = Policy::None;
+    int interval = 1000;  ///< ms
+    int records = 100;
+};
+
+/** @brief A log file, for a room or meeting
+ *
+ * Each entry is formatted once, and then handed to the sinks that
+ * are selected for this log: see Sink. The file itself is written
+ * by a background thread, which does the actual disk I/O; closing
+ * the file waits for everything logged so far to be written.
+ *
+ * The file is really a series of segments in the log directory,
+ * rotated according to the LogRotation; re-opening a log with the
+ * same name appends to it.
+ */
 class LoggerFile
 {
 public:
+    /// @brief Kinds of sink; a log with no sinks at all discards everything
+    enum class Sink
+    {
+        File = 0x1,  ///< The file named in open() (while open)
+        Console = 0x2,  ///< qDebug() output
+        Json = 0x4,  ///< One JSON object per line on standard output
+        Events = 0x8,  ///< Binary event log next to the file (while open), see EventLogWriter
+        Index = 0x10,  ///< Search index next to meeting notes logs (while open), see LogSearch
+    };
+    Q_DECLARE_FLAGS(Sinks, Sink)
+
+    /// @brief Creates a (closed) log with the default sinks
     LoggerFile();
     virtual ~LoggerFile();
 
     void log(const Quotient::RoomMessageEvent* message);
     void log(const QString& s);
-    void log(const MessageData& message);
+    /// @brief Logs @p message, whose text is in @p store
+    void log(const MessageStore& store, const MessageData& message);
 
+    /** @brief Opens the log called @p name
+     *
+     * The segments are `quatbot-<name>.log`, `quatbot-<name>.1.log`, ..
+     * in the log directory, listed in `quatbot-<name>.manifest.json`;
+     * compressed segments have a `.z` suffix. Use LogReader to read them.
+     * The binary event log, if selected, is `quatbot-<name>.events`,
+     * and the search index is `quatbot-<name>.index`.
+     * Without a name, the log is just `quatbot`. See LogPaths for
+     * the directory; the log stays closed if the room (see setRoom())
+     * has opened too many logs already.
+     */
     void open(const QString& name);
     void close();
-    bool isOpen() const { return m_stream != nullptr; }
-    QString fileName() const { return m_file ? m_file->fileName() : QString(); }
+    bool isOpen() const { return m_fileSink != nullptr; }
+    /// @brief The segment that was current when the log was opened
+    QString fileName() const { return m_fileName; }
     int lineCount() const { return m_lines; }
+    /// @brief Asks the sinks to get everything logged so far out there (does not wait)
     void flush();
+    /// @brief Syncs of the file so far (since it was opened)
+    LogSyncStats syncStats() const;
+    /// @brief Entries dropped (by any sink) since the log was opened, see LogService::write()
+    quint64 dropped() const;
+
+    /// @brief Sets the room this log belongs to, which limits the number of logs it opens
+    void setRoom(const QString& room) { m_room = room; }
+
+    /// @brief Selects the sinks for this log; the file sink applies from the next open()
+    void setSinks(Sinks sinks);
+    Sinks sinks() const { return m_sinks; }
+
+    /** @brief Sets the sinks for logs created from now on
+     *
+     * This is meant to be called once, at startup, from a
+     * command-line option (see parseSinks()).
+     */
+    static void setDefaultSinks(Sinks sinks);
+    static Sinks defaultSinks();
+
+    /** @brief Parses a comma-separated list of sink names
+     *
+     * The names are *file*, *console*, *json*, *events* and *index*; *none* selects no sinks.
+     * Sets @p ok to @c false if there is an unknown name.
+     */
+    static Sinks parseSinks(const QString& names, bool* ok = nullptr);
+
+    /// @brief Sets the rotation for logs opened from now on
+    static void setRotation(const LogRotation& rotation);
+    static LogRotation rotation();
+    /// @brief Sets when logs opened from now on are synced to disk
+    static void setDurability(const LogDurability& durability);
+    static LogDurability durability();
+    /** @brief Parses a sync policy into @p durability
+     *
+     * The policy is *none*, *close*, *interval:<ms>* or *every:<count>*.
+     * Returns @c false (leaving @p durability alone) if it is invalid.
+     */
+    static bool parseDurability(const QString& policy, LogDurability& durability);
 
 private:
-    QFile* m_file = nullptr;
-    QTextStream* m_stream = nullptr;
+    /// @brief Formats one log entry and hands it to the sinks; an invalid @p timestamp is left blank
+    void write(const QDateTime& timestamp, QStringView sender, QStringView eventId, QStringView message);
+
+    Sinks m_sinks;
+    LogSink* m_fileSink = nullptr;  ///< Only while open
+    LogSink* m_eventSink = nullptr;  ///< Only while open, if selected
+    LogSink* m_indexSink = nullptr;  ///< Only while open, if selected
+    QList<LogSink*> m_otherSinks;  ///< Console and structured output
+    QString m_room;
+    QString m_fileName;
+    QString m_buffer;  ///< Formatted entry, re-used for each entry
     int m_lines = 0;
+};
 
-    QString makeName(QString);  // Copied because it is modified in the method
+Q_DECLARE_OPERATORS_FOR_FLAGS(LoggerFile::Sinks)
+
+/** @brief Command-line options for logging
+ *
+ * The executables that log share these options; add them to
+ * the parser, and apply them (once, at startup) after parsing.
+ */
+class LogOptions
+{
+public:
+    LogOptions();
+
+    void addTo(QCommandLineParser& parser) const;
+    /// @brief Sets the logging defaults; returns @c false (with a warning) if an option is invalid
+    bool apply(const QCommandLineParser& parser) const;
+
+private:
+    QCommandLineOption m_sinks;
+    QCommandLineOption m_directory;
+    QCommandLineOption m_shardLevels;
+    QCommandLineOption m_maxPerRoom;
+    QCommandLineOption m_segmentSize;
+    QCommandLineOption m_segmentTime;
+    QCommandLineOption m_keep;
+    QCommandLineOption m_compress;
+    QCommandLineOption m_sync;
+    QCommandLineOption m_threads;
+    QCommandLineOption m_maxOpen;
 };
 
 }  // namespace QuatBot
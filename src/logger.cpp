@@ -8,13 +8,20 @@
 #include "logger.h"
 
 #include "log_impl.h"
+#include "logindex.h"
+#include "logpaths.h"
 #include "quatbot.h"
 
 #include <room.h>
 
 #include <QFile>
+#include <QPointer>
 #include <QRegularExpression>
+#include <QRunnable>
 #include <QTextStream>
+#include <QThreadPool>
+
+#include <atomic>
 
 namespace QuatBot
 {
@@ -22,6 +29,7 @@ Logger::Logger(Bot* parent)
     : Watcher(parent)
     , d(new LoggerFile)
 {
+    d->setRoom(parent->botRoom());
 }
 
 Logger::~Logger()
@@ -37,10 +45,15 @@ const QString& Logger::moduleName() const
 
 const QStringList& Logger::moduleCommands() const
 {
-    static const QStringList commands { "on", "off", "status" };
+    static const QStringList commands { "on", "off", "status", "search" };
     return commands;
 }
 
+Logger::Interests Logger::interests() const
+{
+    return Interest::Messages | Interest::BotMessages | Interest::Commands;
+}
+
 void Logger::handleMessage(const Quotient::RoomMessageEvent* event)
 {
     d->log(event);
@@ -48,8 +61,8 @@ void Logger::handleMessage(const Quotient::RoomMessageEvent* event)
 
 void Logger::handleMessage(const QString& s)
 {
+    // Not flushed: the writer picks it up anyway, and syncing is up to the durability policy
     d->log(s);
-    d->flush();
 }
 
 static void report(Bot* bot, LoggerFile* file)
@@ -57,15 +70,115 @@ static void report(Bot* bot, LoggerFile* file)
     if (!file->isOpen())
     {
         bot->message("(log) Logging is off.");
+        return;
     }
-    else if (file->lineCount() > 0)
+    if (file->lineCount() > 0)
     {
-        bot->message(QString("(log) Logging to %1, %2 lines.").arg(file->fileName(), file->lineCount()));
+        bot->message(QString("(log) Logging to %1, %2 lines.").arg(file->fileName()).arg(file->lineCount()));
     }
     else
     {
         bot->message(QString("(log) Logging to %1").arg(file->fileName()));
     }
+
+    const auto stats = file->syncStats();
+    if (stats.count > 0)
+    {
+        bot->message(QString("(log) Synced %1 times, average %2ms, longest %3ms.")
+                         .arg(stats.count)
+                         .arg(stats.averageTime() / 1000.0, 0, 'f', 1)
+                         .arg(stats.maxTime / 1000.0, 0, 'f', 1));
+    }
+    if (file->dropped() > 0)
+    {
+        bot->message(QString("(log) %1 entries were dropped because the disk could not keep up.")
+                         .arg(file->dropped()));
+    }
+}
+
+/** @brief The thread that runs searches
+ *
+ * Reading an index the first time takes a while, so searches do
+ * not run on the bot's thread. One long-lived thread is plenty;
+ * searches from all the rooms queue up for it.
+ */
+static QThreadPool* searchPool()
+{
+    static QThreadPool* pool = []()
+    {
+        auto* p = new QThreadPool;
+        p->setMaxThreadCount(1);
+        p->setExpiryTimeout(-1);
+        return p;
+    }();
+    return pool;
+}
+
+/// @brief Searches queued or running, see search()
+static std::atomic<int> s_searches { 0 };
+
+/** @brief Searches the meeting notes of @p room for @p terms, and tells the room
+ *
+ * The search is queued for the search thread, unless too many are
+ * waiting already. The results are reported back on the bot's
+ * thread (unless the bot is gone by then).
+ */
+static void search(Bot* bot, const QString& room, const QStringList& terms)
+{
+    static constexpr const int maxResults = 5;
+    static constexpr const int maxLength = 80;
+    static constexpr const int maxSearches = 4;
+
+    if (s_searches.fetch_add(1) >= maxSearches)
+    {
+        --s_searches;
+        bot->message(QStringLiteral("(log) Too many searches running, try again later."));
+        return;
+    }
+
+    // Lives on the bot's thread until the results are in, so it is always safe to post to
+    auto* reply = new QObject;
+    QPointer<Bot> guard(bot);
+    searchPool()->start(QRunnable::create(
+        [reply, guard, room, terms]()
+        {
+            // Only this room's notes: the other rooms' are none of its business
+            const QStringList files = LogPaths::findNotes(room, QStringLiteral(".index"));
+            const auto results = LogSearch::instance().search(files, terms, maxResults);
+            --s_searches;
+            QMetaObject::invokeMethod(
+                reply,
+                [reply, guard, terms, results]()
+                {
+                    reply->deleteLater();
+                    Bot* bot = guard.data();
+                    if (!bot)
+                    {
+                        return;
+                    }
+                    if (results.isEmpty())
+                    {
+                        bot->message(QString("(log) Nothing found for '%1'.").arg(terms.join(' ')));
+                    }
+                    else
+                    {
+                        bot->message(QString("(log) Found for '%1':").arg(terms.join(' ')));
+                    }
+                    for (const auto& r : results)
+                    {
+                        const QString when
+                            = r.timestamp.isValid() ? r.timestamp.toString("yyyy-MM-dd HH:mm") : r.log;
+                        QString text = r.message.simplified();
+                        if (text.length() > maxLength)
+                        {
+                            text = text.left(maxLength - 3) + QStringLiteral("...");
+                        }
+                        bot->message(QString("%1 %2: %3").arg(when, r.sender, text));
+                    }
+                    bot->message(Bot::Flush {});
+                },
+                Qt::QueuedConnection);
+        }));
 }
 
 void Logger::handleCommand(const CommandArgs& cmd)
@@ -110,6 +223,15 @@ void Logger::handleCommand(const CommandArgs& cmd)
     {
         report(m_bot, d);
     }
+    else if (cmd.command == "search")
+    {
+        if (cmd.args.isEmpty())
+        {
+            message(QStringLiteral("Usage: %1 search <terms..>").arg(displayCommand()));
+            return;
+        }
+        search(m_bot, m_bot->botRoom(), cmd.args);
+    }
     else
     {
         message(Usage {});
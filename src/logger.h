@@ -25,6 +25,7 @@ public:
 
     const QString& moduleName() const override;
     const QStringList& moduleCommands() const override;
+    Interests interests() const override;
 
     virtual void handleMessage(const QString&) override;
     virtual void handleMessage(const Quotient::RoomMessageEvent*) override;
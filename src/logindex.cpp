@@ -0,0 +1,263 @@
+/*
+ *  SPDX-License-Identifier: BSD-2-Clause
+ *  SPDX-License-File: LICENSE
+ *
+ * Copyright 2026 Adriaan de Groot <groot@kde.org>
+ */
+
+#include "logindex.h"
+
+#include <QDataStream>
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QSet>
+#include <QtEndian>
+
+#include <algorithm>
+
+namespace QuatBot
+{
+// Each record is a 4-byte (big-endian) length and then that many bytes
+// of QDataStream; the length makes it easy to spot a partial record.
+static constexpr const int LENGTH_SIZE = 4;
+static constexpr const QDataStream::Version STREAM_VERSION = QDataStream::Qt_5_12;
+
+QStringList LogIndex::terms(QStringView text)
+{
+    QStringList terms;
+    QSet<QString> seen;
+    int start = -1;
+    for (int i = 0; i <= text.size(); ++i)
+    {
+        const bool inWord = i < text.size() && text[i].isLetterOrNumber();
+        if (inWord && start < 0)
+        {
+            start = i;
+        }
+        else if (!inWord && start >= 0)
+        {
+            if (i - start >= 2)
+            {
+                const QString term = text.mid(start, i - start).toString().toLower();
+                if (!seen.contains(term))
+                {
+                    seen.insert(term);
+                    terms.append(term);
+                }
+            }
+            start = -1;
+        }
+    }
+    return terms;
+}
+
+/// @brief Reads one record from @p f; returns false at the end or at a partial (or bogus) record
+static bool readRecord(QFile& f, QByteArray& record)
+{
+    const QByteArray length = f.read(LENGTH_SIZE);
+    if (length.size() < LENGTH_SIZE)
+    {
+        return false;
+    }
+    // Don't believe a length that runs past the end of the file
+    const quint32 size = qFromBigEndian<quint32>(length.constData());
+    if (size > f.size() - f.pos())
+    {
+        return false;
+    }
+    record = f.read(size);
+    return record.size() == int(size);
+}
+
+LogIndexWriter::LogIndexWriter(const QString& fileName)
+    : m_fileName(fileName)
+    , m_stream(fileName, false)
+{
+}
+
+LogIndexWriter::~LogIndexWriter()
+{
+    if (m_added)
+    {
+        LogService::instance().remove(&m_stream);
+    }
+}
+
+bool LogIndexWriter::open()
+{
+    QFile f(m_fileName);
+    if (!f.open(QFile::ReadWrite))
+    {
+        qCritical() << "Could not open index" << m_fileName;
+        return false;
+    }
+    // Drop a partial record from a crash, so that new ones can be read
+    qint64 valid = 0;
+    QByteArray record;
+    while (readRecord(f, record))
+    {
+        valid = f.pos();
+    }
+    if (valid < f.size())
+    {
+        qWarning() << "Dropping incomplete entry at the end of" << m_fileName;
+        f.resize(valid);
+    }
+    f.close();
+
+    LogService::instance().add(&m_stream);
+    m_added = true;
+    return true;
+}
+
+void LogIndexWriter::add(const QDateTime& timestamp, QStringView sender, QStringView message)
+{
+    if (!m_added)
+    {
+        return;
+    }
+
+    m_record = QByteArray(LENGTH_SIZE, '\0');
+    {
+        QDataStream out(&m_record, QIODevice::WriteOnly | QIODevice::Append);
+        out.setVersion(STREAM_VERSION);
+        // The bot's own messages have no timestamp; use the time they were logged
+        out << qint64(timestamp.isValid() ? timestamp.toMSecsSinceEpoch() : QDateTime::currentMSecsSinceEpoch())
+            << sender.toString() << message.toString() << LogIndex::terms(message);
+    }
+    qToBigEndian<quint32>(quint32(m_record.size() - LENGTH_SIZE), m_record.data());
+    LogService::instance().write(&m_stream, m_record);
+}
+
+LogSearch& LogSearch::instance()
+{
+    static LogSearch search;
+    return search;
+}
+
+void LogSearch::refresh(const QString& fileName, IndexedFile& index)
+{
+    QFile f(fileName);
+    if (!f.open(QFile::ReadOnly))
+    {
+        return;
+    }
+    if (f.size() < index.offset)
+    {
+        // Replaced by something else, start over
+        index = IndexedFile {};
+    }
+    f.seek(index.offset);
+
+    QByteArray record;
+    qint64 timestamp = 0;
+    QString sender;
+    QString message;
+    QStringList terms;
+    while (readRecord(f, record))
+    {
+        QDataStream in(record);
+        in.setVersion(STREAM_VERSION);
+        in >> timestamp >> sender >> message >> terms;
+        if (in.status() == QDataStream::Ok)
+        {
+            const int entryIndex = index.entries.count();
+            index.entries.append(index.offset);
+            for (const auto& t : terms)
+            {
+                index.postings[t].append(entryIndex);
+            }
+        }
+        index.offset = f.pos();
+    }
+}
+
+bool LogSearch::readEntry(QFile& f, qint64 offset, Result& result)
+{
+    QByteArray record;
+    if (!f.seek(offset) || !readRecord(f, record))
+    {
+        return false;
+    }
+    QDataStream in(record);
+    in.setVersion(STREAM_VERSION);
+    qint64 timestamp = 0;
+    in >> timestamp >> result.sender >> result.message;
+    result.timestamp = timestamp ? QDateTime::fromMSecsSinceEpoch(timestamp, Qt::UTC) : QDateTime();
+    return in.status() == QDataStream::Ok;
+}
+
+QVector<LogSearch::Result> LogSearch::search(const QStringList& files, const QStringList& terms, int max)
+{
+    const QStringList wanted = LogIndex::terms(terms.join(' '));
+    QVector<Result> results;
+    if (wanted.isEmpty() || max <= 0)
+    {
+        return results;
+    }
+
+    QMutexLocker lock(&m_mutex);
+    for (const auto& path : files)
+    {
+        IndexedFile& index = m_files[path];
+        refresh(path, index);
+
+        QVector<const QVector<int>*> postings;
+        for (const auto& t : wanted)
+        {
+            const auto it = index.postings.constFind(t);
+            if (it == index.postings.constEnd())
+            {
+                postings.clear();
+                break;
+            }
+            postings.append(&it.value());
+        }
+        if (postings.isEmpty())
+        {
+            continue;
+        }
+        // Walk the shortest list, and look up in the others
+        std::sort(postings.begin(),
+                  postings.end(),
+                  [](const QVector<int>* a, const QVector<int>* b) { return a->count() < b->count(); });
+
+        QFile f(path);
+        if (!f.open(QFile::ReadOnly))
+        {
+            continue;
+        }
+        Result result;
+        result.log = QFileInfo(path).completeBaseName();
+        const auto& shortest = *postings.first();
+        // Most recent first, and no more than needed from each file
+        int found = 0;
+        for (auto it = shortest.crbegin(); it != shortest.crend() && found < max; ++it)
+        {
+            const int entryIndex = *it;
+            const bool all
+                = std::all_of(postings.cbegin() + 1,
+                              postings.cend(),
+                              [entryIndex](const QVector<int>* p)
+                              { return std::binary_search(p->cbegin(), p->cend(), entryIndex); });
+            if (all && readEntry(f, index.entries[entryIndex], result))
+            {
+                results.append(result);
+                ++found;
+            }
+        }
+    }
+
+    std::sort(results.begin(),
+              results.end(),
+              [](const Result& a, const Result& b) { return a.timestamp > b.timestamp; });
+    if (results.count() > max)
+    {
+        results.resize(max);
+    }
+    return results;
+}
+
+}  // namespace QuatBot
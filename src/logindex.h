@@ -0,0 +1,116 @@
+/*
+ *  SPDX-License-Identifier: BSD-2-Clause
+ *  SPDX-License-File: LICENSE
+ *
+ * Copyright 2026 Adriaan de Groot <groot@kde.org>
+ */
+
+#ifndef QUATBOT_LOGINDEX_H
+#define QUATBOT_LOGINDEX_H
+
+#include "logservice.h"
+
+#include <QDateTime>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+#include <QStringView>
+#include <QVector>
+
+namespace QuatBot
+{
+/** @brief Search index for logs
+ *
+ * Next to a log, an index file `quatbot-<name>.index` collects the
+ * entries of the log together with the search terms in each.
+ * The index is appended to as the log is written (see
+ * LoggerFile::Sink::Index), and read incrementally by LogSearch,
+ * which keeps the inverted index (term to entries) in memory; the
+ * entries themselves are read from the file again when found.
+ *
+ * The index file is a sequence of QDataStream records: the timestamp
+ * (ms since the epoch, or 0), sender, message, and the terms.
+ */
+namespace LogIndex
+{
+/** @brief The search terms in @p text
+ *
+ * Terms are the words (runs of letters and digits) of at least
+ * two characters, in lower case, without duplicates.
+ */
+QStringList terms(QStringView text);
+}  // namespace LogIndex
+
+/** @brief Appends entries to an index file
+ *
+ * Entries are encoded on the calling thread, and written by the
+ * LogService as soon as possible, so that searches (possibly from
+ * another room) find them.
+ */
+class LogIndexWriter
+{
+public:
+    explicit LogIndexWriter(const QString& fileName);
+    ~LogIndexWriter();
+
+    bool open();
+    void add(const QDateTime& timestamp, QStringView sender, QStringView message);
+    /// @brief Entries dropped because the disk could not keep up
+    quint64 dropped() const { return m_stream.dropped(); }
+
+private:
+    QString m_fileName;
+    AppendStream m_stream;
+    bool m_added = false;
+    QByteArray m_record;  ///< Re-used for each entry
+};
+
+/** @brief Searches log indexes
+ *
+ * There is one (thread-safe) instance for the whole process, so
+ * that the bots for all the rooms share what is read from the
+ * index files. Each search first reads whatever was added to the
+ * index files since the previous one, so a search is only slow
+ * the first time. Search from a thread other than the bot's.
+ */
+class LogSearch
+{
+public:
+    struct Result
+    {
+        QDateTime timestamp;  ///< Invalid for messages from the bot itself
+        QString sender;
+        QString message;
+        QString log;  ///< Name of the index file, without directory and suffix
+    };
+
+    static LogSearch& instance();
+
+    /** @brief Finds entries containing all of @p terms
+     *
+     * Searches the index @p files (e.g. from LogPaths::find()). Returns
+     * the (at most) @p max most-recent results, most-recent first.
+     */
+    QVector<Result> search(const QStringList& files, const QStringList& terms, int max);
+
+private:
+    struct IndexedFile
+    {
+        qint64 offset = 0;  ///< Read up to here
+        QVector<qint64> entries;  ///< File offset of each entry's record
+        QHash<QString, QVector<int>> postings;  ///< Term to entry indexes, ascending
+    };
+
+    /// @brief Reads what was added to @p fileName since the last time
+    void refresh(const QString& fileName, IndexedFile& index);
+    /// @brief Reads the entry at @p offset of (open) index file @p f into @p result
+    static bool readEntry(QFile& f, qint64 offset, Result& result);
+
+    QMutex m_mutex;
+    QHash<QString, IndexedFile> m_files;
+};
+
+}  // namespace QuatBot
+#endif
@@ -0,0 +1,298 @@
+/*
+ *  SPDX-License-Identifier: BSD-2-Clause
+ *  SPDX-License-File: LICENSE
+ *
+ * Copyright 2026 Adriaan de Groot <groot@kde.org>
+ */
+
+#include "logpaths.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRegularExpression>
+#include <QSet>
+
+#include <algorithm>
+
+namespace QuatBot
+{
+static constexpr const int MAX_SHARD_LEVELS = 2;
+/// @brief Resolved names to remember; there may be many more logs than that
+static constexpr const int MAX_CACHED_PATHS = 1024;
+
+/// @brief Configuration, set once at startup
+static QString s_root = QStringLiteral("/tmp");
+static int s_shardLevels = 0;
+static int s_maxLogsPerRoom = 0;
+
+/// @brief Resolved names, the logs used by each room, and the shards in use (relative to the root)
+static QMutex s_mutex;
+static QHash<QString, QString> s_paths;
+static QHash<QString, QSet<QString>> s_roomLogs;
+static QSet<QString> s_shards;
+static bool s_shardsLoaded = false;
+
+/// @brief The lines of text file @p path (none if it does not exist)
+static QStringList readLines(const QString& path)
+{
+    QFile f(path);
+    if (!f.open(QFile::ReadOnly | QFile::Text))
+    {
+        return QStringList();
+    }
+    return QString::fromUtf8(f.readAll()).split('\n', Qt::SkipEmptyParts);
+}
+
+static void appendLine(const QString& path, const QString& line)
+{
+    QFile f(path);
+    if (!f.open(QFile::Append | QFile::Text))
+    {
+        qWarning() << "Could not update" << path;
+        return;
+    }
+    f.write(line.toUtf8() + '\n');
+}
+
+/// @brief Lists the shards in use, one per line, so that find() need not look in every possible one
+static QString shardsFile()
+{
+    return QDir(s_root).filePath(QStringLiteral("quatbot-shards.list"));
+}
+
+/// @brief Lists the logs used by @p room, one per line
+static QString roomFile(const QString& room)
+{
+    return QDir(s_root).filePath(
+        QString("quatbot-rooms/%1.list").arg(LogPaths::sanitize(room, LogPaths::Dashes::Keep)));
+}
+
+QString LogPaths::sanitize(QString name, Dashes dashes)
+{
+    static const QRegularExpression removeDashes(QStringLiteral("[^a-zA-Z0-9_]"));
+    static const QRegularExpression keepDashes(QStringLiteral("[^a-zA-Z0-9_-]"));
+    return name.remove(dashes == Dashes::Keep ? keepDashes : removeDashes);
+}
+
+void LogPaths::setRoot(const QString& path)
+{
+    QMutexLocker lock(&s_mutex);
+    s_root = path;
+    s_paths.clear();
+    s_roomLogs.clear();
+    s_shards.clear();
+    s_shardsLoaded = false;
+}
+
+QString LogPaths::root()
+{
+    return s_root;
+}
+
+void LogPaths::setShardLevels(int levels)
+{
+    QMutexLocker lock(&s_mutex);
+    s_shardLevels = qBound(0, levels, MAX_SHARD_LEVELS);
+    s_paths.clear();
+    s_shards.clear();
+    s_shardsLoaded = false;
+}
+
+int LogPaths::shardLevels()
+{
+    return s_shardLevels;
+}
+
+void LogPaths::setMaxLogsPerRoom(int count)
+{
+    s_maxLogsPerRoom = qMax(0, count);
+}
+
+/// @brief FNV-1a; unlike qHash(), this is the same for every run of the bot
+static quint32 nameHash(const QString& name)
+{
+    quint32 h = 2166136261u;
+    for (const QChar c : name)
+    {
+        h = (h ^ c.unicode()) * 16777619u;
+    }
+    return h;
+}
+
+/// @brief Adds the shards @p levels deep below @p dir (as @p prefix) that hold files, to @p shards
+static void findShards(const QDir& dir, const QString& prefix, int levels, QSet<QString>& shards)
+{
+    static const QRegularExpression shard(QStringLiteral("^[0-9a-f]{2}$"));
+    for (const auto& name : dir.entryList(QDir::Dirs | QDir::NoDotAndDotDot))
+    {
+        if (!shard.match(name).hasMatch())
+        {
+            continue;
+        }
+        const QString path = prefix.isEmpty() ? name : prefix + '/' + name;
+        if (levels > 1)
+        {
+            findShards(QDir(dir.filePath(name)), path, levels - 1, shards);
+        }
+        else if (!QDir(dir.filePath(name)).isEmpty(QDir::Files))
+        {
+            shards.insert(path);
+        }
+    }
+}
+
+/// @brief Reads the shards in use, if not done yet; call with s_mutex locked
+static void loadShards()
+{
+    if (s_shardsLoaded)
+    {
+        return;
+    }
+    s_shardsLoaded = true;
+    if (s_shardLevels <= 0)
+    {
+        return;
+    }
+    if (QFile::exists(shardsFile()))
+    {
+        const QStringList lines = readLines(shardsFile());
+        s_shards = QSet<QString>(lines.cbegin(), lines.cend());
+        return;
+    }
+    // Logs from before the list was kept; look for them once
+    findShards(QDir(s_root), QString(), s_shardLevels, s_shards);
+    QDir().mkpath(s_root);
+    for (const auto& s : s_shards)
+    {
+        appendLine(shardsFile(), s);
+    }
+    appendLine(shardsFile(), QString());  // Creates the file even if there are no shards yet
+}
+
+QString LogPaths::resolve(const QString& name)
+{
+    QMutexLocker lock(&s_mutex);
+    auto it = s_paths.constFind(name);
+    if (it != s_paths.constEnd())
+    {
+        return it.value();
+    }
+
+    const QString clean = sanitize(name);
+    QString shard;
+    if (!clean.isEmpty())
+    {
+        const quint32 h = nameHash(clean);
+        for (int level = 0; level < s_shardLevels; ++level)
+        {
+            shard += QString(level ? "/%1" : "%1").arg((h >> (8 * level)) & 0xff, 2, 16, QChar('0'));
+        }
+    }
+    const QString directory = shard.isEmpty() ? s_root : s_root + '/' + shard;
+    if (!QDir().mkpath(directory))
+    {
+        qWarning() << "Could not create log directory" << directory;
+    }
+    loadShards();
+    if (!shard.isEmpty() && !s_shards.contains(shard))
+    {
+        s_shards.insert(shard);
+        appendLine(shardsFile(), shard);
+    }
+
+    const QString path = QDir(directory).filePath(clean.isEmpty() ? QStringLiteral("quatbot")
+                                                                  : QString("quatbot-%1").arg(clean));
+    if (s_paths.count() >= MAX_CACHED_PATHS)
+    {
+        s_paths.clear();
+    }
+    s_paths.insert(name, path);
+    return path;
+}
+
+bool LogPaths::claim(const QString& room, const QString& name)
+{
+    if (room.isEmpty() || s_maxLogsPerRoom <= 0)
+    {
+        return true;
+    }
+    const QString clean = sanitize(name);
+    QMutexLocker lock(&s_mutex);
+    auto it = s_roomLogs.find(room);
+    if (it == s_roomLogs.end())
+    {
+        // The logs from earlier runs count too
+        const QStringList lines = readLines(roomFile(room));
+        it = s_roomLogs.insert(room, QSet<QString>(lines.cbegin(), lines.cend()));
+    }
+    auto& logs = it.value();
+    if (logs.contains(clean))
+    {
+        return true;
+    }
+    if (logs.count() >= s_maxLogsPerRoom)
+    {
+        qWarning() << "Room" << room << "may not open more than" << s_maxLogsPerRoom << "logs";
+        return false;
+    }
+    logs.insert(clean);
+    QDir().mkpath(QFileInfo(roomFile(room)).absolutePath());
+    appendLine(roomFile(room), clean);
+    return true;
+}
+
+/// @brief Adds the files matching @p pattern in @p dir
+static void findIn(const QDir& dir, const QStringList& pattern, QStringList& files)
+{
+    for (const auto& name : dir.entryList(pattern, QDir::Files))
+    {
+        files.append(dir.filePath(name));
+    }
+}
+
+QStringList LogPaths::find(const QString& pattern)
+{
+    QSet<QString> shards;
+    {
+        QMutexLocker lock(&s_mutex);
+        loadShards();
+        shards = s_shards;
+    }
+
+    QStringList files;
+    const QDir root(s_root);
+    findIn(root, QStringList { pattern }, files);
+    for (const auto& s : shards)
+    {
+        findIn(QDir(root.filePath(s)), QStringList { pattern }, files);
+    }
+    return files;
+}
+
+QString LogPaths::notesName(const QString& room, const QDate& date)
+{
+    int year = 0;
+    const int week = date.weekNumber(&year);
+    return QString("notes_%1_%2_%3").arg(sanitize(room)).arg(year).arg(week, 2, 10, QChar('0'));
+}
+
+QStringList LogPaths::findNotes(const QString& room, const QString& suffix)
+{
+    // The wildcard alone would also match rooms whose name starts with this one's
+    const QString prefix = QString("quatbot-notes_%1_").arg(sanitize(room));
+    const QRegularExpression exact(QString("^%1[0-9]+_[0-9]+%2$")
+                                       .arg(QRegularExpression::escape(prefix), QRegularExpression::escape(suffix)));
+    QStringList files = find(prefix + '*' + suffix);
+    files.erase(std::remove_if(files.begin(),
+                               files.end(),
+                               [&exact](const QString& f) { return !exact.match(QFileInfo(f).fileName()).hasMatch(); }),
+                files.end());
+    return files;
+}
+
+}  // namespace QuatBot
@@ -0,0 +1,86 @@
+/*
+ *  SPDX-License-Identifier: BSD-2-Clause
+ *  SPDX-License-File: LICENSE
+ *
+ * Copyright 2026 Adriaan de Groot <groot@kde.org>
+ */
+
+#ifndef QUATBOT_LOGPATHS_H
+#define QUATBOT_LOGPATHS_H
+
+#include <QDate>
+#include <QString>
+#include <QStringList>
+
+namespace QuatBot
+{
+/** @brief Where the log files go
+ *
+ * A log called `<name>` lives in the log root (`/tmp` unless
+ * configured otherwise) as `quatbot-<name>.log` and so on. With
+ * many logs in one directory, looking up files gets slow; with
+ * sharding, each log goes into a subdirectory of the root named
+ * after a hash of its name, e.g. `<root>/3f/quatbot-<name>.log`
+ * for one level of sharding, or `<root>/3f/a0/..` for two.
+ *
+ * Some resolved names are cached, and the directories are created the
+ * first time a name is resolved. The shard directories in use are
+ * listed in `quatbot-shards.list` in the root, so that find() looks
+ * only in those; the logs each room uses are listed in
+ * `quatbot-rooms/<room>.list`, so that the limit holds across runs. The configuration (setRoot(),
+ * setShardLevels(), setMaxLogsPerRoom()) is meant to be set once,
+ * at startup; all the other methods are thread-safe.
+ */
+class LogPaths
+{
+public:
+    enum class Dashes
+    {
+        Remove,
+        Keep
+    };
+
+    /// @brief Removes everything from @p name that is not a letter, digit or underscore (or dash, if kept)
+    static QString sanitize(QString name, Dashes dashes = Dashes::Remove);
+
+    /// @brief Sets the log root directory (default `/tmp`)
+    static void setRoot(const QString& path);
+    static QString root();
+    /// @brief Sets the number of levels of subdirectories (0, the default, for none; at most 2)
+    static void setShardLevels(int levels);
+    static int shardLevels();
+    /// @brief Sets how many different logs each room may open (0 for no limit)
+    static void setMaxLogsPerRoom(int count);
+
+    /** @brief The path of log @p name, without suffix
+     *
+     * This is `<root>/<shards>/quatbot-<name>` with @p name sanitized,
+     * or just `quatbot` for an empty name. The directory is created
+     * if needed.
+     */
+    static QString resolve(const QString& name);
+
+    /** @brief Lets @p room use log @p name
+     *
+     * Returns @c false (with a warning) if @p room has already
+     * used as many different logs as allowed (also in earlier runs
+     * of the bot, with the same root). Using the same log again is
+     * always allowed; an empty @p room has no limit.
+     */
+    static bool claim(const QString& room, const QString& name);
+
+    /// @brief Log files matching the wildcard @p pattern, in the root and the shards in use
+    static QStringList find(const QString& pattern);
+
+    /** @brief Name of the meeting notes log of @p room for the week of @p date
+     *
+     * This is `notes_<room>_<year>_<week>`, with @p room sanitized,
+     * so that each room has notes of its own.
+     */
+    static QString notesName(const QString& room, const QDate& date);
+    /// @brief The meeting notes files of @p room (only) with @p suffix, e.g. `.index`
+    static QStringList findNotes(const QString& room, const QString& suffix);
+};
+
+}  // namespace QuatBot
+#endif
@@ -0,0 +1,167 @@
+/*
+ *  SPDX-License-Identifier: BSD-2-Clause
+ *  SPDX-License-File: LICENSE
+ *
+ * Copyright 2026 Adriaan de Groot <groot@kde.org>
+ */
+
+#include "logreader.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QIODevice>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QtEndian>
+
+namespace QuatBot
+{
+namespace CompressedSegment
+{
+const char suffix[] = ".z";
+
+static const char MAGIC[] = "QBZ1";
+static constexpr const int MAGIC_SIZE = 4;
+static constexpr const int LENGTH_SIZE = 4;
+
+QByteArray header()
+{
+    return QByteArray(MAGIC, MAGIC_SIZE);
+}
+
+QByteArray block(const QByteArray& text)
+{
+    const QByteArray compressed = qCompress(text);
+    QByteArray b(LENGTH_SIZE, '\0');
+    qToBigEndian<quint32>(quint32(compressed.size()), b.data());
+    b.append(compressed);
+    return b;
+}
+
+/// @brief Reads the next block from @p device; returns false at the end (or a partial or bogus block)
+static bool readBlock(QIODevice& device, QByteArray& compressed)
+{
+    const QByteArray length = device.read(LENGTH_SIZE);
+    if (length.size() < LENGTH_SIZE)
+    {
+        return false;
+    }
+    // Don't believe a length that runs past the end of the file
+    const quint32 size = qFromBigEndian<quint32>(length.constData());
+    const qint64 left = device.isSequential() ? device.bytesAvailable() : device.size() - device.pos();
+    if (size > left)
+    {
+        return false;
+    }
+    compressed = device.read(size);
+    return compressed.size() == int(size);
+}
+
+qint64 validLength(QIODevice& device)
+{
+    if (device.read(MAGIC_SIZE) != header())
+    {
+        return -1;
+    }
+    qint64 valid = device.pos();
+    QByteArray compressed;
+    while (readBlock(device, compressed))
+    {
+        valid = device.pos();
+    }
+    return valid;
+}
+
+}  // namespace CompressedSegment
+
+LogReader::LogReader(const QString& path)
+{
+    static const QString manifestSuffix = QStringLiteral(".manifest.json");
+
+    QString manifest;
+    if (path.endsWith(manifestSuffix))
+    {
+        manifest = path;
+    }
+    else if (QFile::exists(path + manifestSuffix))
+    {
+        manifest = path + manifestSuffix;
+    }
+    else
+    {
+        if (QFileInfo(path).isFile())
+        {
+            m_segments.append(path);
+        }
+        return;
+    }
+
+    QFile f(manifest);
+    if (!f.open(QFile::ReadOnly))
+    {
+        qWarning() << "Could not read log manifest" << manifest;
+        return;
+    }
+    const QDir dir = QFileInfo(manifest).absoluteDir();
+    const QJsonObject o = QJsonDocument::fromJson(f.readAll()).object();
+    for (const auto& v : o.value(QStringLiteral("segments")).toArray())
+    {
+        const QString file = v.toObject().value(QStringLiteral("file")).toString();
+        if (!file.isEmpty())
+        {
+            m_segments.append(dir.filePath(file));
+        }
+    }
+}
+
+bool LogReader::read(const Consumer& consumer) const
+{
+    bool ok = true;
+    for (const auto& s : m_segments)
+    {
+        ok = readSegment(s, consumer) && ok;
+    }
+    return ok;
+}
+
+bool LogReader::readSegment(const QString& fileName, const Consumer& consumer)
+{
+    QFile f(fileName);
+    if (!f.open(QFile::ReadOnly))
+    {
+        qWarning() << "Could not open log segment" << fileName;
+        return false;
+    }
+
+    if (!fileName.endsWith(QLatin1String(CompressedSegment::suffix)))
+    {
+        while (!f.atEnd())
+        {
+            consumer(f.read(64 * 1024));
+        }
+        return true;
+    }
+
+    if (f.read(CompressedSegment::MAGIC_SIZE) != CompressedSegment::header())
+    {
+        qWarning() << "Log segment" << fileName << "is not compressed.";
+        return false;
+    }
+    QByteArray compressed;
+    while (CompressedSegment::readBlock(f, compressed))
+    {
+        const QByteArray text = qUncompress(compressed);
+        if (text.isEmpty() && !compressed.isEmpty())
+        {
+            qWarning() << "Log segment" << fileName << "has a damaged block at" << f.pos();
+            return false;
+        }
+        consumer(text);
+    }
+    return true;
+}
+
+}  // namespace QuatBot
@@ -0,0 +1,76 @@
+/*
+ *  SPDX-License-Identifier: BSD-2-Clause
+ *  SPDX-License-File: LICENSE
+ *
+ * Copyright 2026 Adriaan de Groot <groot@kde.org>
+ */
+
+#ifndef QUATBOT_LOGREADER_H
+#define QUATBOT_LOGREADER_H
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+
+#include <functional>
+
+class QIODevice;
+
+namespace QuatBot
+{
+/** @brief Compressed log segments
+ *
+ * A compressed segment starts with a 4-byte magic, followed by
+ * blocks. Each block is a 4-byte (big-endian) length and then that
+ * many bytes of qCompress()ed log text. Blocks are independent, so
+ * a segment can be read up to its last complete block while it is
+ * still being written, or after the writer crashed halfway a block.
+ */
+namespace CompressedSegment
+{
+/// @brief File-name suffix of compressed segments
+extern const char suffix[];
+
+/// @brief Magic at the start of a compressed segment
+QByteArray header();
+/// @brief Compresses @p text into one block, length included
+QByteArray block(const QByteArray& text);
+/** @brief Length of the readable part of the segment in @p device
+ *
+ * This is the header and all the complete blocks; anything after
+ * that is a partially-written block. Returns -1 if the device
+ * does not hold a compressed segment at all.
+ */
+qint64 validLength(QIODevice& device);
+}  // namespace CompressedSegment
+
+/** @brief Reads back logs written by LoggerFile
+ *
+ * A log is read through its manifest, segment by segment, so the
+ * reader can be given the manifest, or the name of the log (the
+ * manifest without `.manifest.json`). It can also be given a single
+ * segment file. Compressed segments are decompressed.
+ */
+class LogReader
+{
+public:
+    /// @brief Called with each piece of log text, in order
+    using Consumer = std::function<void(const QByteArray&)>;
+
+    explicit LogReader(const QString& path);
+
+    /// @brief The segment files of the log, oldest first; empty if there is no such log
+    QStringList segments() const { return m_segments; }
+
+    /// @brief Reads all the segments; returns @c false if one could not be read
+    bool read(const Consumer& consumer) const;
+
+    /// @brief Reads the single segment @p fileName
+    static bool readSegment(const QString& fileName, const Consumer& consumer);
+
+private:
+    QStringList m_segments;
+};
+
+}  // namespace QuatBot
+#endif
@@ -0,0 +1,347 @@
+/*
+ *  SPDX-License-Identifier: BSD-2-Clause
+ *  SPDX-License-File: LICENSE
+ *
+ * Copyright 2026 Adriaan de Groot <groot@kde.org>
+ */
+
+#include "logservice.h"
+
+#include <QDebug>
+#include <QMutexLocker>
+#include <QThread>
+
+#include <unistd.h>
+
+namespace QuatBot
+{
+/// @brief Configuration of the service, set once at startup
+static int s_threads = 2;
+static int s_maxOpenFiles = 64;
+
+/// @brief Data buffered for each stream; beyond that, entries are dropped
+static constexpr const int MAX_PENDING = 4 * 1024 * 1024;
+
+/** @brief One writer thread of the LogService
+ *
+ * The worker waits for streams with pending data, and writes
+ * them. It keeps track of which of its streams have their
+ * file open, most-recently-written last.
+ */
+class LogWorker
+{
+public:
+    explicit LogWorker(int maxOpen)
+        : m_maxOpen(qMax(1, maxOpen))
+        , m_thread(QThread::create([this]() { run(); }))
+    {
+        m_thread->start();
+    }
+
+    ~LogWorker()
+    {
+        {
+            QMutexLocker lock(&m_mutex);
+            m_stop = true;
+        }
+        m_wake.release();
+        m_thread->wait();
+        delete m_thread;
+    }
+
+    void add(LogStream* stream)
+    {
+        QMutexLocker lock(&m_mutex);
+        m_added.append(stream);
+    }
+
+    /// @brief There is something to do for @p stream
+    void queue(LogStream* stream)
+    {
+        {
+            QMutexLocker lock(&m_mutex);
+            m_dirty.append(stream);
+        }
+        m_wake.release();
+    }
+
+    /// @brief Returns @c false if the worker has already stopped (and finished all its streams)
+    bool remove(LogStream* stream)
+    {
+        {
+            QMutexLocker lock(&m_mutex);
+            if (m_stop)
+            {
+                return false;
+            }
+            m_removed.append(stream);
+        }
+        m_wake.release();
+        return true;
+    }
+
+private:
+    void run()
+    {
+        while (true)
+        {
+            int timeout = -1;
+            for (const auto* s : qAsConst(m_streams))
+            {
+                const int t = s->waitTime();
+                if (t >= 0)
+                {
+                    timeout = timeout < 0 ? t : qMin(timeout, t);
+                }
+            }
+            if (timeout < 0)
+            {
+                m_wake.acquire();
+            }
+            else if (!m_wake.tryAcquire(1, timeout))
+            {
+                idle();
+                continue;
+            }
+            // Whatever woke us up, everything queued is handled now
+            m_wake.tryAcquire(m_wake.available());
+
+            QList<LogStream*> dirty;
+            QList<LogStream*> removed;
+            bool stopping = false;
+            {
+                QMutexLocker lock(&m_mutex);
+                m_streams.append(m_added);
+                m_added.clear();
+                dirty.swap(m_dirty);
+                removed.swap(m_removed);
+                stopping = m_stop;
+            }
+
+            for (auto* s : qAsConst(dirty))
+            {
+                write(s);
+            }
+            for (auto* s : qAsConst(removed))
+            {
+                finish(s);
+                s->m_removed.release();
+            }
+            if (stopping)
+            {
+                // Streams whose owners never removed them still get written out
+                const auto streams = m_streams;
+                for (auto* s : streams)
+                {
+                    finish(s);
+                }
+                return;
+            }
+        }
+    }
+
+    /// @brief Makes @p stream the most-recently used, closing the least-recently used files if needed
+    void touch(LogStream* stream)
+    {
+        if (!m_open.isEmpty() && m_open.last() == stream)
+        {
+            return;
+        }
+        m_open.removeOne(stream);
+        while (m_open.count() >= m_maxOpen)
+        {
+            m_open.takeFirst()->suspend();
+        }
+        m_open.append(stream);
+    }
+
+    void write(LogStream* stream)
+    {
+        QByteArray data;
+        int entries = 0;
+        bool flush = false;
+        {
+            QMutexLocker lock(&stream->m_mutex);
+            data.swap(stream->m_pending);
+            entries = stream->m_pendingEntries;
+            flush = stream->m_flush;
+            stream->m_pendingEntries = 0;
+            stream->m_flush = false;
+            stream->m_queued = false;
+        }
+        if (data.isEmpty() && !flush)
+        {
+            return;
+        }
+        touch(stream);
+        if (!data.isEmpty())
+        {
+            stream->writeData(data, entries);
+        }
+        if (flush)
+        {
+            stream->flushRequested();
+        }
+    }
+
+    void idle()
+    {
+        for (auto* s : qAsConst(m_streams))
+        {
+            if (s->waitTime() == 0)
+            {
+                touch(s);
+                s->idle();
+            }
+        }
+    }
+
+    void finish(LogStream* stream)
+    {
+        write(stream);
+        touch(stream);
+        stream->finish();
+        m_open.removeOne(stream);
+        m_streams.removeOne(stream);
+    }
+
+    const int m_maxOpen;
+
+    QMutex m_mutex;  // Protects the lists shared with other threads
+    QList<LogStream*> m_added;
+    QList<LogStream*> m_dirty;
+    QList<LogStream*> m_removed;
+    bool m_stop = false;
+
+    QSemaphore m_wake;
+    QThread* m_thread;
+
+    // These belong to the worker thread
+    QList<LogStream*> m_streams;
+    QList<LogStream*> m_open;  ///< Least-recently used first
+};
+
+LogStream::LogStream() {}
+
+LogStream::~LogStream() {}
+
+AppendStream::AppendStream(const QString& fileName, bool syncOnClose)
+    : m_file(fileName)
+    , m_syncOnClose(syncOnClose)
+{
+}
+
+void AppendStream::writeData(const QByteArray& data, int)
+{
+    if (!m_file.isOpen() && !m_file.open(QFile::WriteOnly | QFile::Append))
+    {
+        qWarning() << "Could not open" << m_file.fileName();
+        return;
+    }
+    m_file.write(data);
+    m_file.flush();
+    m_written = true;
+}
+
+void AppendStream::suspend()
+{
+    m_file.close();
+}
+
+void AppendStream::finish()
+{
+    // The file may have been suspended since the last write; fsync() covers writes through any descriptor
+    if (m_syncOnClose && m_written && (m_file.isOpen() || m_file.open(QFile::WriteOnly | QFile::Append)))
+    {
+        m_file.flush();
+        if (::fsync(m_file.handle()) != 0)
+        {
+            qWarning() << "Could not sync" << m_file.fileName();
+        }
+    }
+    m_file.close();
+}
+
+void LogService::setThreads(int count)
+{
+    s_threads = qMax(1, count);
+}
+
+void LogService::setMaxOpenFiles(int count)
+{
+    s_maxOpenFiles = qMax(1, count);
+}
+
+LogService& LogService::instance()
+{
+    static LogService service;
+    return service;
+}
+
+LogService::LogService()
+{
+    const int perWorker = qMax(1, s_maxOpenFiles / s_threads);
+    for (int i = 0; i < s_threads; ++i)
+    {
+        m_workers.append(new LogWorker(perWorker));
+    }
+}
+
+LogService::~LogService()
+{
+    qDeleteAll(m_workers);
+}
+
+void LogService::add(LogStream* stream)
+{
+    stream->m_worker = m_workers[int(m_next.fetch_add(1) % unsigned(m_workers.count()))];
+    stream->m_worker->add(stream);
+}
+
+bool LogService::write(LogStream* stream, const QByteArray& data, int entries)
+{
+    bool queue = false;
+    {
+        QMutexLocker lock(&stream->m_mutex);
+        // Never wait for the writer here: the caller is the bot's thread
+        if (!stream->m_pending.isEmpty() && stream->m_pending.size() + data.size() > MAX_PENDING)
+        {
+            stream->m_dropped += quint64(entries);
+            return false;
+        }
+        stream->m_pending.append(data);
+        stream->m_pendingEntries += entries;
+        queue = !stream->m_queued;
+        stream->m_queued = true;
+    }
+    if (queue)
+    {
+        stream->m_worker->queue(stream);
+    }
+    return true;
+}
+
+void LogService::flush(LogStream* stream)
+{
+    bool queue = false;
+    {
+        QMutexLocker lock(&stream->m_mutex);
+        stream->m_flush = true;
+        queue = !stream->m_queued;
+        stream->m_queued = true;
+    }
+    if (queue)
+    {
+        stream->m_worker->queue(stream);
+    }
+}
+
+void LogService::remove(LogStream* stream)
+{
+    if (stream->m_worker->remove(stream))
+    {
+        stream->m_removed.acquire();
+    }
+}
+
+}  // namespace QuatBot
@@ -0,0 +1,138 @@
+/*
+ *  SPDX-License-Identifier: BSD-2-Clause
+ *  SPDX-License-File: LICENSE
+ *
+ * Copyright 2026 Adriaan de Groot <groot@kde.org>
+ */
+
+#ifndef QUATBOT_LOGSERVICE_H
+#define QUATBOT_LOGSERVICE_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QList>
+#include <QMutex>
+#include <QSemaphore>
+#include <QString>
+
+#include <atomic>
+
+namespace QuatBot
+{
+class LogWorker;
+
+/** @brief A file written by the LogService
+ *
+ * The owner of the stream hands data to the service (see
+ * LogService::write()), which buffers it in the stream; one of
+ * the service's writer threads then calls writeData() with
+ * everything buffered. All the virtual methods are called on
+ * that writer thread, one at a time.
+ *
+ * The service keeps only so many files open: a stream may be
+ * told to suspend() (close its file) at any time between calls,
+ * and must re-open its file when it next needs it.
+ */
+class LogStream
+{
+public:
+    LogStream();
+    virtual ~LogStream();
+
+    /// @brief Writes @p data, which holds @p entries whole entries
+    virtual void writeData(const QByteArray& data, int entries) = 0;
+    /// @brief The owner asked for everything to get out of memory buffers
+    virtual void flushRequested() {}
+    /// @brief Time (in ms) until idle() wants to be called, or -1 for never
+    virtual int waitTime() const { return -1; }
+    /// @brief Called when nothing was written for a while, see waitTime()
+    virtual void idle() {}
+    /// @brief Closes the file, for now
+    virtual void suspend() = 0;
+    /// @brief Called last, after all data has been written
+    virtual void finish() {}
+
+    /// @brief Entries dropped because the writer could not keep up, see LogService::write()
+    quint64 dropped() const { return m_dropped.load(); }
+
+private:
+    friend class LogService;
+    friend class LogWorker;
+
+    // These are shared between the owner and the writer thread
+    QMutex m_mutex;
+    QByteArray m_pending;
+    int m_pendingEntries = 0;
+    bool m_flush = false;
+    bool m_queued = false;
+    std::atomic<quint64> m_dropped { 0 };
+
+    LogWorker* m_worker = nullptr;
+    QSemaphore m_removed;
+};
+
+/** @brief Plain append-only file, as a LogStream */
+class AppendStream : public LogStream
+{
+public:
+    /// @brief The file is synced to disk when finished if @p syncOnClose is set
+    AppendStream(const QString& fileName, bool syncOnClose);
+
+    void writeData(const QByteArray& data, int entries) override;
+    void suspend() override;
+    void finish() override;
+
+private:
+    QFile m_file;
+    const bool m_syncOnClose;
+    bool m_written = false;  ///< Anything to sync when finished
+};
+
+/** @brief Writes all the log files of the process
+ *
+ * With a bot in each of hundreds of rooms, a thread and a file
+ * handle for each log does not scale. The service has a fixed
+ * number of writer threads, and each stream is assigned to one
+ * of them. Each writer thread keeps a limited number of files
+ * open, closing the least-recently written one when needed.
+ *
+ * Configure the service (setThreads(), setMaxOpenFiles()) at
+ * startup, before the first stream is added.
+ */
+class LogService
+{
+public:
+    static LogService& instance();
+    ~LogService();
+
+    static void setThreads(int count);
+    static void setMaxOpenFiles(int count);
+
+    /// @brief Starts writing @p stream; the service does not own it
+    void add(LogStream* stream);
+    /** @brief Queues @p data (holding @p entries entries) for writing to @p stream
+     *
+     * Each stream buffers a limited amount of data. When that is full
+     * (the disk can't keep up), the data is dropped right away and
+     * counted (see LogStream::dropped()), rather than holding up the
+     * caller or using ever more memory. Returns @c false if dropped.
+     */
+    bool write(LogStream* stream, const QByteArray& data, int entries = 1);
+    /// @brief Asks the writer to get @p stream out of memory buffers (does not wait)
+    void flush(LogStream* stream);
+    /** @brief Stops writing @p stream
+     *
+     * This waits until everything queued for @p stream is written
+     * and the stream is finished; then the stream may be deleted.
+     */
+    void remove(LogStream* stream);
+
+private:
+    LogService();
+
+    QList<LogWorker*> m_workers;
+    std::atomic<unsigned int> m_next { 0 };  ///< Worker for the next stream
+};
+
+}  // namespace QuatBot
+#endif
@@ -31,6 +31,11 @@
 #include <events/roommessageevent.h>
 
 #include "command.h"
+#include "log_impl.h"
+#include "shard.h"
+
+#include <memory>
+#include <vector>
 
 int main(int argc, char** argv)
 {
@@ -43,6 +48,13 @@ int main(int argc, char** argv)
         QStringList { "p", "password" }, "Password to use to connect (will prompt if unset).", "password");
     QCommandLineOption operatorOption(
         QStringList { "o", "operator" }, "Additional user-id to consider as operator.", "userid");
+    QCommandLineOption windowOption(QStringList { "w", "message-window" },
+                                    "Time to collect outgoing messages before sending them (default 0).",
+                                    "ms");
+    QCommandLineOption threadsOption(QStringList { "t", "threads" },
+                                     "Spread the rooms over this many threads (default 0, all on the main thread).",
+                                     "count");
+    QuatBot::LogOptions logOptions;
     QCommandLineParser parser;
     parser.setApplicationDescription("Chatbot for meeting-management on Matrix");
     parser.addHelpOption();
@@ -50,6 +62,9 @@ int main(int argc, char** argv)
     parser.addOption(userOption);
     parser.addOption(passOption);
     parser.addOption(operatorOption);
+    parser.addOption(windowOption);
+    parser.addOption(threadsOption);
+    logOptions.addTo(parser);
     parser.addPositionalArgument("rooms", "Room names to join", "[rooms..]");
     parser.process(app);
 
@@ -59,27 +74,57 @@ int main(int argc, char** argv)
                       "  Give at least one room name.\n";
         return 1;
     }
+    if (!logOptions.apply(parser))
+    {
+        qWarning() << "Usage: quatbot <options> <room..>\n"
+                      "  Check the logging options.\n";
+        return 1;
+    }
 
     QObject::connect(QMatrixClient::NetworkAccessManager::instance(),
                      &QNetworkAccessManager::sslErrors,
                      [](QNetworkReply* reply, const QList<QSslError>& errors) { reply->ignoreSslErrors(errors); });
 
+    // Kept for the shards, which each log in by themselves
+    const QString password
+        = parser.isSet(passOption) ? parser.value(passOption) : QString(getpass("Matrix password: "));
     QMatrixClient::Connection conn;
-    conn.connectToServer(parser.value(userOption),
-                         parser.isSet(passOption) ? parser.value(passOption) : QString(getpass("Matrix password: ")),
-                         "quatbot");  // user pass device
+    conn.connectToServer(parser.value(userOption), password, "quatbot");  // user pass device
 
+    const QStringList operators = parser.values(operatorOption);
+    const int messageWindow = parser.isSet(windowOption) ? parser.value(windowOption).toInt() : -1;
+    auto startBot = [operators, messageWindow](QMatrixClient::Connection& c, const QString& room)
+    {
+        // Gets cleaned up by itself
+        QuatBot::Bot* bot = new QuatBot::Bot(c, room, operators);
+        if (messageWindow >= 0)
+        {
+            bot->setMessageWindow(messageWindow);
+        }
+    };
+
+    std::vector<std::unique_ptr<QuatBot::Shard>> shards;
     QObject::connect(&conn,
                      &QMatrixClient::Connection::connected,
                      [&]()
                      {
                          qDebug() << "Connected to" << conn.homeserver() << "as" << conn.userId();
+                         const int threads = parser.value(threadsOption).toInt();
+                         if (threads > 0)
+                         {
+                             // Each shard has its own connection; this one is only for finding the server
+                             for (auto* s : QuatBot::makeShards(parser.positionalArguments(), threads, startBot))
+                             {
+                                 shards.emplace_back(s);
+                                 s->start(conn, password);
+                             }
+                             return;
+                         }
                          conn.setLazyLoading(false);
                          conn.syncLoop();
                          for (const auto& r : parser.positionalArguments())
                          {
-                             // Unused, gets cleaned up by itself
-                             QuatBot::Bot* bot = new QuatBot::Bot(conn, r, parser.values(operatorOption));
+                             startBot(conn, r);
                          }
                      });
     QObject::connect(
@@ -19,8 +19,11 @@
 #include <QCommandLineParser>
 #include <QCoreApplication>
 #include <QDebug>
+#include <QFile>
 #include <QNetworkReply>
 #include <QObject>
+#include <QStandardPaths>
+#include <QTextStream>
 #include <QTimer>
 
 #include <connection.h>
@@ -31,6 +34,9 @@
 #include <events/roommessageevent.h>
 
 #include "command.h"
+#include "eventlog.h"
+#include "log_impl.h"
+#include "logreader.h"
 
 int main(int argc, char** argv)
 {
@@ -45,6 +51,20 @@ int main(int argc, char** argv)
     QCommandLineOption amountOption(QStringList { "n", "message-count" }, "Number of messages to load", "count");
     QCommandLineOption sinceOption(
         QStringList { "s", "since" }, "Start date-time to load (yyyy-MM-ddTHH:mm:ss)", "since");
+    QCommandLineOption readOption(QStringList { "r", "read" },
+                                  "Print a log written earlier (its name, manifest or a segment), then exit.",
+                                  "log");
+    QCommandLineOption bufferPagesOption(QStringList { "buffer-pages" },
+                                         "Number of fetched history pages that may wait to be processed; "
+                                         "one request is on its way at a time (default 2).",
+                                         "pages");
+    QCommandLineOption streamOption(QStringList { "stream" },
+                                    "Write history to a temporary file as it arrives, to use little memory.");
+    QCommandLineOption cacheOption(QStringList { "cache-dir" },
+                                   "Directory for the cache of history fetched earlier (default: the user's cache).",
+                                   "dir");
+    QCommandLineOption noCacheOption(QStringList { "no-cache" }, "Do not cache history.");
+    QuatBot::LogOptions logOptions;
     QCommandLineParser parser;
     parser.setApplicationDescription("History-dumper on Matrix");
     parser.addHelpOption();
@@ -54,9 +74,47 @@ int main(int argc, char** argv)
     parser.addOption(usersOnlyOption);
     parser.addOption(amountOption);
     parser.addOption(sinceOption);
+    parser.addOption(readOption);
+    parser.addOption(bufferPagesOption);
+    parser.addOption(streamOption);
+    parser.addOption(cacheOption);
+    parser.addOption(noCacheOption);
+    logOptions.addTo(parser);
     parser.addPositionalArgument("rooms", "Room names to join", "[rooms..]");
     parser.process(app);
 
+    if (parser.isSet(readOption) && parser.value(readOption).endsWith(".events"))
+    {
+        QuatBot::EventLogReader reader(parser.value(readOption));
+        if (!reader.isValid())
+        {
+            return 1;
+        }
+        QTextStream out(stdout);
+        QuatBot::EventRecord record;
+        while (reader.next(record))
+        {
+            const QString timestamp = record.timestamp == QuatBot::EventLog::noTimestamp
+                ? QString()
+                : QDateTime::fromMSecsSinceEpoch(record.timestamp, Qt::UTC).toString(Qt::ISODate);
+            out << timestamp << '\t' << reader.sender(record.sender) << '\t' << QString::fromUtf8(record.eventId)
+                << '\t' << QString::fromUtf8(record.body) << '\n';
+        }
+        return 0;
+    }
+    if (parser.isSet(readOption))
+    {
+        const QuatBot::LogReader reader(parser.value(readOption));
+        if (reader.segments().isEmpty())
+        {
+            qWarning() << "There is no log" << parser.value(readOption);
+            return 1;
+        }
+        QFile out;
+        out.open(stdout, QIODevice::WriteOnly);
+        return reader.read([&out](const QByteArray& text) { out.write(text); }) ? 0 : 1;
+    }
+
     if (parser.positionalArguments().count() < 1)
     {
         qWarning() << "Usage: qb-dumper <options> <room..>\n"
@@ -69,6 +127,16 @@ int main(int argc, char** argv)
                       "  Specify only one of -n|--message-count and -s|--since\n";
         return 1;
     }
+    if (!logOptions.apply(parser))
+    {
+        qWarning() << "Usage: qb-dumper <options> <room..>\n"
+                      "  Check the logging options.\n";
+        return 1;
+    }
+
+    const QString cacheDirectory = parser.isSet(cacheOption)
+        ? parser.value(cacheOption)
+        : QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QStringLiteral("/history");
 
     QObject::connect(QMatrixClient::NetworkAccessManager::instance(),
                      &QNetworkAccessManager::sslErrors,
@@ -91,6 +159,12 @@ int main(int argc, char** argv)
                              // Unused, gets cleaned up by itself
                              auto* bot = new QuatBot::DumpBot(conn, r);
                              bot->setShowUsersOnly(parser.isSet(usersOnlyOption));
+                             bot->setStreaming(parser.isSet(streamOption));
+                             bot->setCache(parser.isSet(noCacheOption) ? QString() : cacheDirectory);
+                             if (parser.isSet(bufferPagesOption))
+                             {
+                                 bot->setBufferPages(parser.value(bufferPagesOption).toInt());
+                             }
                              if (parser.isSet(amountOption))
                              {
                                  bot->setLogCriterion(parser.value(amountOption).toUInt());
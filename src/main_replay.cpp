@@ -0,0 +1,298 @@
+/*
+ *  SPDX-License-Identifier: BSD-2-Clause
+ *  SPDX-License-File: LICENSE
+ *
+ * Copyright 2026 Adriaan de Groot <groot@kde.org>
+ */
+
+/* This is the main entry for QuatBot-Replay, which feeds recorded
+ * room events through the bot -- all the watchers, and the outgoing
+ * messages -- without a homeserver. It reports how fast that goes,
+ * for measuring and regression-testing the message-handling path.
+ */
+
+#include "replay.h"
+
+#include "log_impl.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+#include <QTimer>
+#include <QVector>
+
+#include <connection.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <functional>
+
+#ifdef __GLIBC__
+// Count allocations by interposing the allocation functions; Qt containers
+// allocate with malloc() directly, and operator new ends up here as well.
+// The aligned variants (used by aligned operator new, among others) have no
+// __libc_ entry point of their own, so they all go through __libc_memalign().
+extern "C"
+{
+    void* __libc_malloc(size_t size) noexcept;
+    void* __libc_calloc(size_t count, size_t size) noexcept;
+    void* __libc_realloc(void* p, size_t size) noexcept;
+    void* __libc_memalign(size_t alignment, size_t size) noexcept;
+}
+
+static std::atomic<quint64> allocationCount { 0 };
+
+extern "C"
+{
+    void* malloc(size_t size) noexcept
+    {
+        allocationCount.fetch_add(1, std::memory_order_relaxed);
+        return __libc_malloc(size);
+    }
+    void* calloc(size_t count, size_t size) noexcept
+    {
+        allocationCount.fetch_add(1, std::memory_order_relaxed);
+        return __libc_calloc(count, size);
+    }
+    void* realloc(void* p, size_t size) noexcept
+    {
+        allocationCount.fetch_add(1, std::memory_order_relaxed);
+        return __libc_realloc(p, size);
+    }
+    void* memalign(size_t alignment, size_t size) noexcept
+    {
+        allocationCount.fetch_add(1, std::memory_order_relaxed);
+        return __libc_memalign(alignment, size);
+    }
+    void* aligned_alloc(size_t alignment, size_t size) noexcept
+    {
+        allocationCount.fetch_add(1, std::memory_order_relaxed);
+        return __libc_memalign(alignment, size);
+    }
+    int posix_memalign(void** p, size_t alignment, size_t size) noexcept
+    {
+        if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0)
+        {
+            return EINVAL;
+        }
+        allocationCount.fetch_add(1, std::memory_order_relaxed);
+        void* result = __libc_memalign(alignment, size);
+        if (!result && size != 0)
+        {
+            return ENOMEM;
+        }
+        *p = result;
+        return 0;
+    }
+}
+
+static bool countsAllocations()
+{
+    return true;
+}
+static quint64 allocations()
+{
+    return allocationCount.load();
+}
+#else
+static bool countsAllocations()
+{
+    return false;
+}
+static quint64 allocations()
+{
+    return 0;
+}
+#endif
+
+/// @brief Reads one event per line from @p fileName
+static QVector<QJsonObject> loadEvents(const QString& fileName)
+{
+    QVector<QJsonObject> events;
+
+    QFile f(fileName);
+    if (!f.open(QIODevice::ReadOnly))
+    {
+        qWarning() << "Could not open" << fileName;
+        return events;
+    }
+
+    int lineNumber = 0;
+    while (!f.atEnd())
+    {
+        const QByteArray line = f.readLine().trimmed();
+        ++lineNumber;
+        if (line.isEmpty())
+        {
+            continue;
+        }
+        QJsonParseError error;
+        const QJsonDocument doc = QJsonDocument::fromJson(line, &error);
+        if (!doc.isObject())
+        {
+            qWarning() << "Line" << lineNumber << "is not a JSON object:" << error.errorString();
+            continue;
+        }
+        events.append(doc.object());
+    }
+    return events;
+}
+
+/// @brief Replays the events in batches, one batch per pass through the event loop
+class Replayer
+{
+public:
+    Replayer(QuatBot::ReplayBot& bot, const QVector<QJsonObject>& events, int batchSize)
+        : m_bot(bot)
+        , m_events(events)
+        , m_batchSize(qMax(1, batchSize))
+    {
+    }
+
+    void start() { QTimer::singleShot(0, [this]() { batch(); }); }
+
+    int messageCount() const { return m_messages; }
+    qint64 elapsed() const { return m_elapsed; }
+    quint64 allocationCount() const { return m_allocations; }
+
+    /// @brief Called once all the events have been replayed
+    std::function<void()> finished;
+
+private:
+    void batch()
+    {
+        const quint64 allocationsBefore = allocations();
+        QElapsedTimer t;
+        t.start();
+
+        const int end = std::min(m_next + m_batchSize, m_events.count());
+        for (; m_next < end; ++m_next)
+        {
+            if (m_bot.replay(m_events[m_next]))
+            {
+                ++m_messages;
+            }
+        }
+
+        m_elapsed += t.nsecsElapsed();
+        m_allocations += allocations() - allocationsBefore;
+
+        if (m_next < m_events.count())
+        {
+            QTimer::singleShot(0, [this]() { batch(); });
+        }
+        else if (finished)
+        {
+            // One more pass so that the outbox delivers the last messages
+            QTimer::singleShot(0, finished);
+        }
+    }
+
+    QuatBot::ReplayBot& m_bot;
+    const QVector<QJsonObject>& m_events;
+    const int m_batchSize;
+    int m_next = 0;
+    int m_messages = 0;
+    qint64 m_elapsed = 0;  // nanoseconds
+    quint64 m_allocations = 0;
+};
+
+int main(int argc, char** argv)
+{
+    QCoreApplication app(argc, argv);
+    // Separate name, so that the coffee module doesn't use the real cookie jar
+    app.setApplicationName("QuatBot-Replay");
+    app.setApplicationVersion("0.8");
+
+    QCommandLineOption operatorOption(
+        QStringList { "o", "operator" }, "Additional user-id to consider as operator.", "userid");
+    QCommandLineOption roomOption(QStringList { "r", "room" }, "Room name to use (default 'replay').", "room");
+    QCommandLineOption batchOption(
+        QStringList { "b", "batch" }, "Number of events to handle per pass of the event loop (default 100).", "count");
+    QCommandLineOption echoOption(QStringList { "e", "echo" }, "Print the messages the bot sends.");
+    QuatBot::LogOptions logOptions;
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Replays recorded Matrix events through QuatBot");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addOption(operatorOption);
+    parser.addOption(roomOption);
+    parser.addOption(batchOption);
+    parser.addOption(echoOption);
+    logOptions.addTo(parser);
+    parser.addPositionalArgument("events", "JSONL file with one Matrix event per line", "<events.jsonl>");
+    parser.process(app);
+
+    if (parser.positionalArguments().count() != 1)
+    {
+        qWarning() << "Usage: qb-replay <options> <events.jsonl>\n"
+                      "  Give exactly one file of events.\n";
+        return 1;
+    }
+    if (!logOptions.apply(parser))
+    {
+        qWarning() << "Usage: qb-replay <options> <events.jsonl>\n"
+                      "  Check the logging options.\n";
+        return 1;
+    }
+
+    const QVector<QJsonObject> events = loadEvents(parser.positionalArguments().first());
+    if (events.isEmpty())
+    {
+        qWarning() << "No events to replay.";
+        return 1;
+    }
+
+    // Never connected, the bot only needs it for its user id (which is empty)
+    QMatrixClient::Connection conn;
+
+    const QString roomName = parser.isSet(roomOption) ? parser.value(roomOption) : QStringLiteral("replay");
+    auto* bot = new QuatBot::ReplayBot(conn, roomName, parser.values(operatorOption));
+    auto* outbox = new QuatBot::RecordingOutbox;
+    outbox->setEcho(parser.isSet(echoOption));
+    bot->setOutbox(outbox);
+    bot->setProfiling(true);
+
+    Replayer replayer(*bot, events, parser.isSet(batchOption) ? parser.value(batchOption).toInt() : 100);
+    replayer.finished = [&]()
+    {
+        QTextStream out(stdout);
+        const double seconds = replayer.elapsed() / 1e9;
+        out << "Replayed " << events.count() << " events (" << replayer.messageCount() << " messages) in "
+            << QString::number(seconds * 1000.0, 'f', 1) << "ms";
+        if (seconds > 0)
+        {
+            out << ", " << QString::number(replayer.messageCount() / seconds, 'f', 0) << " messages/sec";
+        }
+        out << ".\n";
+        if (countsAllocations())
+        {
+            out << "Allocations: " << replayer.allocationCount();
+            if (replayer.messageCount() > 0)
+            {
+                out << " (" << QString::number(double(replayer.allocationCount()) / replayer.messageCount(), 'f', 1)
+                    << " per message)";
+            }
+            out << ".\n";
+        }
+        out << "The bot sent " << outbox->postCount() << " messages.\n";
+
+        const auto times = bot->watcherTimes();
+        for (auto it = times.cbegin(); it != times.cend(); ++it)
+        {
+            out << "  " << it.key().leftJustified(12) << ' ' << QString::number(it.value() / 1e6, 'f', 3) << "ms\n";
+        }
+        out.flush();
+        QCoreApplication::exit(0);
+    };
+    replayer.start();
+
+    return app.exec();
+}
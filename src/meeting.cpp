@@ -7,6 +7,7 @@
 
 #include "meeting.h"
 
+#include "logpaths.h"
 #include "quatbot.h"
 
 #include <chrono>
@@ -43,13 +44,7 @@ void changeLoggingSetting(QuatBot::Bot& bot, const QuatBot::CommandArgs& cmd, bo
         // sensible name. Remember that the named watchers expect
         // a subcommand, not their main command.
         QuatBot::CommandArgs logCommand(cmd);
-        int year = 0;
-        QString week = QString::number(QDate::currentDate().weekNumber(&year));
-        if (week.length() < 2)
-        {
-            week.prepend('0');
-        }
-        logCommand.id = QString("notes_%1_%2").arg(year).arg(week);
+        logCommand.id = QuatBot::LogPaths::notesName(bot.botRoom(), QDate::currentDate());
         logCommand.command = b ? QStringLiteral("on") : QStringLiteral("off");
         logCommand.args = QStringList { "?quiet" };
         w->handleCommand(logCommand);
@@ -140,6 +135,21 @@ struct Meeting::Private
     }
 
     bool isNew(const QString& s) { return !m_participantsDone.contains(s) && !m_participants.contains(s); }
+
+    /// @brief Room members that are neither participants nor done (nor chair), in the room's order
+    QStringList notResponded() const
+    {
+        const QSet<QString> participants(m_participants.cbegin(), m_participants.cend());
+        QStringList ids;
+        for (const auto& u : m_bot->memberIds())
+        {
+            if ((u != m_chair) && !participants.contains(u) && !m_participantsDone.contains(u))
+            {
+                ids.append(u);
+            }
+        }
+        return ids;
+    }
     bool isChair(const CommandArgs& cmd) { return cmd.user == m_chair; }
 
     void skip(const QString& user)
@@ -295,15 +305,9 @@ void Meeting::handleCommand(const CommandArgs& cmd)
         {
             d->start(cmd.user);
             enableLogging(cmd, true);
-            QStringList ids = m_bot->userIds();
-            ids.removeAll(d->m_chair);
-            for (const auto& u : d->m_participantsDone)
-                ids.removeAll(u);
-            for (const auto& u : d->m_participants)
-                ids.removeAll(u);
             message(QStringList {
                         "Hello @room, this is the roll-call!", QString("%1 is chair.").arg(d->m_chair), "Calling" }
-                    << ids);
+                    << d->notResponded());
         }
         else
         {
@@ -529,19 +533,10 @@ void Meeting::Private::timeout()
 
     if (m_state == State::RollCall)
     {
-        QStringList noResponse { "Roll-call reminder for" };
-
-        for (const auto& u : m_bot->userIds())
-        {
-            if (!m_participants.contains(u) && !m_participantsDone.contains(u))
-            {
-                noResponse.append(u);
-            }
-        }
-
-        if (noResponse.count() > 1)
+        const QStringList noResponse = notResponded();
+        if (noResponse.count() > 0)
         {
-            m_bot->message(noResponse);
+            m_bot->message(QStringList { "Roll-call reminder for" } << noResponse);
         }
     }
     else if (m_state == State::InProgress)
@@ -0,0 +1,173 @@
+/*
+ *  SPDX-License-Identifier: BSD-2-Clause
+ *  SPDX-License-File: LICENSE
+ *
+ * Copyright 2026 Adriaan de Groot <groot@kde.org>
+ */
+
+#include "members.h"
+
+#include <algorithm>
+
+namespace QuatBot
+{
+static QStringList splitUserName(const QString& s)
+{
+    QStringList l;
+    for (QString part : s.split(' ', Qt::SkipEmptyParts))
+    {
+        QString shortPart = part.trimmed();
+        if (!shortPart.isEmpty())
+        {
+            l << shortPart;
+        }
+    }
+    return l;
+}
+
+/** @brief Sort displaynames, longest first, then alphabetical.
+ */
+bool operator<(const MemberIndex::DisplayName& a, const MemberIndex::DisplayName& b)
+{
+    if (a.displayName.count() > b.displayName.count())
+    {
+        return true;
+    }
+    if (a.displayName.count() < b.displayName.count())
+    {
+        return false;
+    }
+
+    // Equal length
+    for (int i = 0; i < a.displayName.count(); ++i)
+    {
+        if (a.displayName[i] < b.displayName[i])
+        {
+            return true;
+        }
+        if (a.displayName[i] > b.displayName[i])
+        {
+            return false;
+        }
+    }
+    // Equal names, order by id so that the order is stable
+    return a.id < b.id;
+}
+
+void MemberIndex::insert(const QString& id, const QString& displayName)
+{
+    auto it = m_names.find(id);
+    if (it != m_names.end())
+    {
+        if (it.value() == displayName)
+        {
+            return;
+        }
+        unindex(id, it.value());
+        it.value() = displayName;
+    }
+    else
+    {
+        m_memberIds.append(id);
+        m_names.insert(id, displayName);
+    }
+    m_ids[displayName].append(id);
+
+    DisplayName d { id, splitUserName(displayName) };
+    if (d.displayName.isEmpty())
+    {
+        return;
+    }
+    auto& names = m_byFirstWord[d.displayName.first()];
+    names.insert(std::lower_bound(names.begin(), names.end(), d), d);
+}
+
+void MemberIndex::remove(const QString& id)
+{
+    auto it = m_names.find(id);
+    if (it != m_names.end())
+    {
+        unindex(id, it.value());
+        m_names.erase(it);
+        m_memberIds.removeOne(id);
+    }
+}
+
+void MemberIndex::clear()
+{
+    m_memberIds.clear();
+    m_names.clear();
+    m_ids.clear();
+    m_byFirstWord.clear();
+}
+
+void MemberIndex::unindex(const QString& id, const QString& displayName)
+{
+    auto named = m_ids.find(displayName);
+    if (named != m_ids.end())
+    {
+        named.value().removeAll(id);
+        if (named.value().isEmpty())
+        {
+            m_ids.erase(named);
+        }
+    }
+
+    const QStringList words = splitUserName(displayName);
+    if (words.isEmpty())
+    {
+        return;
+    }
+    auto it = m_byFirstWord.find(words.first());
+    if (it == m_byFirstWord.end())
+    {
+        return;
+    }
+    auto& names = it.value();
+    names.erase(std::remove_if(names.begin(), names.end(), [&id](const DisplayName& d) { return d.id == id; }),
+                names.end());
+    if (names.isEmpty())
+    {
+        m_byFirstWord.erase(it);
+    }
+}
+
+QString MemberIndex::match(const QStringList& words, int index, int& length) const
+{
+    if ((index < 0) || (index >= words.count()))
+    {
+        return QString();
+    }
+
+    const auto it = m_byFirstWord.constFind(words[index]);
+    if (it == m_byFirstWord.constEnd())
+    {
+        return QString();
+    }
+
+    // Longest first, so the first complete match is the best one
+    for (const auto& [matrixId, userParts] : it.value())
+    {
+        if (index + userParts.count() > words.count())
+        {
+            continue;
+        }
+        bool found = true;
+        for (int j = 1; j < userParts.count(); ++j)
+        {
+            if (userParts[j] != words[index + j])
+            {
+                found = false;
+                break;
+            }
+        }
+        if (found)
+        {
+            length = userParts.count();
+            return matrixId;
+        }
+    }
+    return QString();
+}
+
+}  // namespace QuatBot
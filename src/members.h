@@ -0,0 +1,91 @@
+/*
+ *  SPDX-License-Identifier: BSD-2-Clause
+ *  SPDX-License-File: LICENSE
+ *
+ * Copyright 2026 Adriaan de Groot <groot@kde.org>
+ */
+
+#ifndef QUATBOT_MEMBERS_H
+#define QUATBOT_MEMBERS_H
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+namespace QuatBot
+{
+/** @brief Index of the members of a room, by display name
+ *
+ * Commands name people by nickname, and nicknames can be more than
+ * one word; see Bot::userLookup(). Rather than collecting and sorting
+ * all the display names in the room for each lookup, the bot keeps
+ * this index up-to-date as members join, leave and rename.
+ *
+ * Display names are split into words and indexed by their first word.
+ * For each first word, the names are kept sorted longest first, so
+ * that *adridg the bot* is tried before *adridg*.
+ */
+class MemberIndex
+{
+public:
+    /// @brief Adds member @p id, or updates their @p displayName
+    void insert(const QString& id, const QString& displayName);
+    /// @brief Removes member @p id (if they are in the index)
+    void remove(const QString& id);
+    /// @brief Removes all members
+    void clear();
+
+    /// @brief Is @p id a member?
+    bool contains(const QString& id) const { return m_names.contains(id); }
+    /// @brief Number of members
+    int count() const { return m_names.count(); }
+    /** @brief All the member ids, in the order they were inserted
+     *
+     * This is a (shared, so cheap to copy) snapshot: it does
+     * not change when members join or leave afterwards.
+     */
+    QStringList memberIds() const { return m_memberIds; }
+
+    /** @brief Matrix Ids of the members with display name @p displayName
+     *
+     * This is an exact match on the whole display name. Nicknames are
+     * not unique, so this may return more than one id; the ids are
+     * in no particular order.
+     */
+    QStringList ids(const QString& displayName) const { return m_ids.value(displayName); }
+
+    /** @brief Finds a display name in @p words, starting at @p index
+     *
+     * Returns the Matrix Id of the member with the longest display name
+     * that matches the words starting at @p index, and sets @p length
+     * to the number of words in that display name. If no display
+     * name matches, returns an empty string and @p length is unchanged.
+     */
+    QString match(const QStringList& words, int index, int& length) const;
+
+private:
+    /** @brief Pair of Matrix-Id and split-up displayname.
+     *
+     * This is used in matching names to Matrix-Ids: a command can name
+     * a user, either by Matrix-Id or by nickname. Since nicknames may
+     * be more than one word, we need to be able to match, say
+     * `@adridg:matirx.org` with the nickname *adridg the bot*.
+     */
+    struct DisplayName
+    {
+        QString id;
+        QStringList displayName;
+    };
+    friend bool operator<(const DisplayName& a, const DisplayName& b);
+
+    void unindex(const QString& id, const QString& displayName);
+
+    QStringList m_memberIds;  ///< In the order they were inserted, e.g. the room's order
+    QHash<QString, QString> m_names;  ///< Matrix Id to display name
+    QHash<QString, QStringList> m_ids;  ///< Display name to Matrix Ids
+    QHash<QString, QVector<DisplayName>> m_byFirstWord;  ///< First word to names, sorted
+};
+
+}  // namespace QuatBot
+#endif
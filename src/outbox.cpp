@@ -0,0 +1,198 @@
+/*
+ *  SPDX-License-Identifier: BSD-2-Clause
+ *  SPDX-License-File: LICENSE
+ *
+ * Copyright 2026 Adriaan de Groot <groot@kde.org>
+ */
+
+#include "outbox.h"
+
+#include <room.h>
+
+#include <QDebug>
+
+#include <chrono>
+
+namespace QuatBot
+{
+// A message that is not confirmed after this long is given up on, so that
+// one lost message does not block the outbox forever. Messages that the
+// server refuses are noticed right away, see failed().
+static constexpr const std::chrono::seconds SEND_TIMEOUT(60);
+
+Outbox::Outbox(QObject* parent)
+    : QObject(parent)
+{
+    m_windowTimer.setSingleShot(true);
+    QObject::connect(&m_windowTimer, &QTimer::timeout, this, &Outbox::sendQueued);
+    m_timeoutTimer.setSingleShot(true);
+    QObject::connect(&m_timeoutTimer, &QTimer::timeout, this, &Outbox::timedOut);
+}
+
+Outbox::~Outbox()
+{
+    if (!m_queue.isEmpty())
+    {
+        qWarning() << "Outbox deleted with" << m_queue.count() << "messages unsent.";
+    }
+}
+
+void Outbox::flush()
+{
+    m_windowTimer.stop();
+    if (!m_queue.isEmpty())
+    {
+        send(m_queue.join('\n'));
+        m_queue.clear();
+    }
+}
+
+void Outbox::setRoom(Quotient::Room* room)
+{
+    if (m_room)
+    {
+        QObject::disconnect(m_room, nullptr, this, nullptr);
+    }
+    m_room = room;
+    if (m_room)
+    {
+        QObject::connect(m_room,
+                         &Quotient::Room::messageSent,
+                         this,
+                         [this](const QString& txnId, const QString&) { sent(txnId); });
+        QObject::connect(m_room,
+                         &Quotient::Room::pendingEventChanged,
+                         this,
+                         [this](int index)
+                         {
+                             const auto& pending = m_room->pendingEvents();
+                             if (index < 0 || size_t(index) >= pending.size())
+                             {
+                                 return;
+                             }
+                             const auto& item = pending[size_t(index)];
+                             if (item.deliveryStatus() == Quotient::EventStatus::SendingFailed)
+                             {
+                                 failed(item.event()->transactionId());
+                             }
+                         });
+    }
+}
+
+void Outbox::setWindow(int milliseconds)
+{
+    m_window = qMax(0, milliseconds);
+}
+
+void Outbox::post(const QString& text)
+{
+    if (text.isEmpty())
+    {
+        return;
+    }
+    m_queue.append(text);
+    if (!m_pendingTxnId.isEmpty())
+    {
+        // Will be sent once the server has the previous one
+        return;
+    }
+    if (m_window > 0)
+    {
+        if (!m_windowTimer.isActive())
+        {
+            m_windowTimer.start(m_window);
+        }
+    }
+    else
+    {
+        sendQueued();
+    }
+}
+
+QString Outbox::send(const QString& text)
+{
+    if (!m_room)
+    {
+        return QString();
+    }
+    return m_room->postPlainText(text);
+}
+
+void Outbox::sendQueued()
+{
+    if (!m_pendingTxnId.isEmpty() || m_queue.isEmpty())
+    {
+        return;
+    }
+    m_windowTimer.stop();
+
+    const QString text = m_queue.join('\n');
+    m_queue.clear();
+    m_pendingTime.start();
+    m_retried = false;
+    m_pendingTxnId = send(text);
+    if (!m_pendingTxnId.isEmpty())
+    {
+        m_timeoutTimer.start(SEND_TIMEOUT);
+    }
+}
+
+void Outbox::sent(const QString& txnId)
+{
+    if (m_pendingTxnId.isEmpty() || (txnId != m_pendingTxnId))
+    {
+        return;
+    }
+    m_timeoutTimer.stop();
+    m_pendingTxnId.clear();
+
+    const qint64 latency = m_pendingTime.elapsed();
+    m_sentCount++;
+    m_totalLatency += latency;
+    m_maxLatency = qMax(m_maxLatency, latency);
+
+    if (m_queue.isEmpty())
+    {
+        return;
+    }
+    if (m_window > 0)
+    {
+        m_windowTimer.start(m_window);
+    }
+    else
+    {
+        sendQueued();
+    }
+}
+
+void Outbox::failed(const QString& txnId)
+{
+    if (m_pendingTxnId.isEmpty() || (txnId != m_pendingTxnId))
+    {
+        return;
+    }
+    if (!m_retried)
+    {
+        qWarning() << "Message" << txnId << "could not be sent, retrying.";
+        m_retried = true;
+        m_timeoutTimer.start(SEND_TIMEOUT);
+        m_room->retryMessage(txnId);
+        return;
+    }
+    qWarning() << "Message" << txnId << "could not be sent, dropping it.";
+    m_timeoutTimer.stop();
+    m_room->discardMessage(txnId);
+    m_failedCount++;
+    m_pendingTxnId.clear();
+    sendQueued();
+}
+
+void Outbox::timedOut()
+{
+    qWarning() << "Message" << m_pendingTxnId << "was not confirmed by the server.";
+    m_failedCount++;
+    m_pendingTxnId.clear();
+    sendQueued();
+}
+
+}  // namespace QuatBot
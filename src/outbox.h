@@ -0,0 +1,115 @@
+/*
+ *  SPDX-License-Identifier: BSD-2-Clause
+ *  SPDX-License-File: LICENSE
+ *
+ * Copyright 2026 Adriaan de Groot <groot@kde.org>
+ */
+
+#ifndef QUATBOT_OUTBOX_H
+#define QUATBOT_OUTBOX_H
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+
+namespace Quotient
+{
+class Room;
+}  // namespace Quotient
+
+namespace QuatBot
+{
+/** @brief Outgoing message queue for a room
+ *
+ * The bot collects the messages for one command and flushes them
+ * as a single Matrix message (see Bot::message()). A burst of commands
+ * still produces a burst of messages, and homeservers respond to that
+ * by rate-limiting the bot. The outbox sends only one message at a time:
+ * while a message is on its way to the server (including when libQuotient
+ * is waiting out a rate-limit), further messages are collected and then
+ * sent together as one.
+ *
+ * Optionally, messages are also collected for a short *window* of time
+ * before sending, even if nothing is on its way.
+ */
+class Outbox : public QObject
+{
+public:
+    explicit Outbox(QObject* parent = nullptr);
+    virtual ~Outbox() override;
+
+    /** @brief Sets the room to send to
+     *
+     * Messages are dropped while there is none (unless a subclass
+     * sends them elsewhere, see send()).
+     */
+    void setRoom(Quotient::Room* room);
+
+    /** @brief Sets the time to collect messages before sending
+     *
+     * With a @p milliseconds of 0 (the default), messages are sent
+     * immediately if nothing is on its way to the server.
+     */
+    void setWindow(int milliseconds);
+    int window() const { return m_window; }
+
+    /// @brief Queues @p text for sending
+    void post(const QString& text);
+    /** @brief Sends whatever is queued right away
+     *
+     * This does not wait for anything on its way. Call this before
+     * deleting the outbox: the destructor can't reach send() of a
+     * subclass any more, so it drops what is still queued.
+     */
+    void flush();
+
+    /// @brief Number of messages waiting to be sent
+    int queued() const { return m_queue.count(); }
+    /// @brief Number of (combined) messages sent
+    int sentCount() const { return m_sentCount; }
+    /// @brief Number of (combined) messages that the server refused, or never confirmed
+    int failedCount() const { return m_failedCount; }
+    /// @brief Average time (in milliseconds) for the server to confirm a message
+    qint64 averageLatency() const { return m_sentCount > 0 ? m_totalLatency / m_sentCount : 0; }
+    /// @brief Longest time (in milliseconds) for the server to confirm a message
+    qint64 maxLatency() const { return m_maxLatency; }
+
+protected:
+    /** @brief Sends @p text to the room
+     *
+     * Returns the transaction id of the message; the outbox waits
+     * for that transaction before sending more (see sent()). When
+     * an empty id is returned, the outbox does not wait.
+     */
+    virtual QString send(const QString& text);
+    /// @brief Called when the message with @p txnId has reached the server.
+    void sent(const QString& txnId);
+    /// @brief Called when the server refused the message with @p txnId; retries it once, then drops it
+    void failed(const QString& txnId);
+
+private:
+    /// @brief Sends whatever is queued, unless something is still on its way
+    void sendQueued();
+    /// @brief Gives up on the message that is on its way
+    void timedOut();
+
+    Quotient::Room* m_room = nullptr;
+    QStringList m_queue;
+    QTimer m_windowTimer;
+    QTimer m_timeoutTimer;
+    int m_window = 0;
+
+    QString m_pendingTxnId;  ///< Transaction on its way to the server
+    QElapsedTimer m_pendingTime;
+    bool m_retried = false;  ///< Has the pending transaction been retried already?
+
+    int m_sentCount = 0;
+    int m_failedCount = 0;
+    qint64 m_totalLatency = 0;
+    qint64 m_maxLatency = 0;
+};
+
+}  // namespace QuatBot
+#endif
@@ -9,6 +9,7 @@
 
 #include <QCoreApplication>
 #include <QDebug>
+#include <QElapsedTimer>
 #include <QNetworkReply>
 #include <QObject>
 #include <QTimer>
@@ -21,90 +22,25 @@
 #include <csapi/joining.h>
 #include <events/roommessageevent.h>
 
+#include <atomic>
+
 #ifdef ENABLE_COFFEE
 #include "coffee.h"
 #endif
 #include "command.h"
 #include "logger.h"
 #include "meeting.h"
+#include "outbox.h"
 
 namespace QuatBot
 {
-QStringList splitUserName(const QString& s)
-{
-    QStringList l;
-    for (QString part : s.split(' ', Qt::SkipEmptyParts))
-    {
-        QString shortPart = part.trimmed();
-        if (!shortPart.isEmpty())
-        {
-            l << shortPart;
-        }
-    }
-    return l;
-}
-
-/** @brief Pair of Matrix-Id and split-up displayname.
- *
- * This is used in matching names to Matrix-Ids: a command can name
- * a user, either by Matrix-Id or by nickname. Since nicknames may
- * be more than one word, we need to be able to match, say
- * `@adridg:matirx.org` with the nickname *adridg the bot*.
- *
- * To do that, we'll sort nicknames in the room by length,
- * longest first, so that *adridg the bot* and *adridg* are
- * treated separately (and using the long nickname won't match
- * with the short one first).
- */
-struct DisplayName
-{
-    QString id;
-    QStringList displayName;
-};
-
-/** @brief Sort displaynames, longest first, then alphabetical.
- */
-bool operator<(const DisplayName& a, const DisplayName& b)
-{
-    if (a.displayName.count() > b.displayName.count())
-    {
-        return true;
-    }
-    if (a.displayName.count() < b.displayName.count())
-    {
-        return false;
-    }
-
-    // Equal length
-    for (int i = 0; i < a.displayName.count(); ++i)
-    {
-        if (a.displayName[i] < b.displayName[i])
-        {
-            return true;
-        }
-        if (a.displayName[i] > b.displayName[i])
-        {
-            return false;
-        }
-    }
-    return false;
-}
-
 QStringList Bot::userLookup(const QStringList& users)
 {
     QStringList ids;
 
-    if (!m_room)
+    if (!hasTarget())
         return ids;
 
-    QList<DisplayName> idToDisplayName;
-    idToDisplayName.reserve(m_room->users().count());
-    for (const auto& u : m_room->users())
-    {
-        idToDisplayName.append({ u->id(), splitUserName(u->displayname(m_room)) });
-    }
-    std::sort(idToDisplayName.begin(), idToDisplayName.end());
-
     int i = 0;
     while (i < users.count())
     {
@@ -120,28 +56,16 @@ QStringList Bot::userLookup(const QStringList& users)
         }
         else
         {
-            bool found = false;
-            for (const auto& [matrixId, userParts] : idToDisplayName)
+            int length = 1;
+            const QString matrixId = m_members.match(users, i, length);
+            if (!matrixId.isEmpty())
             {
-                found = userParts.count() > 0;  // initialize to false if the for-loop would be skipped
-                for (int j = 0; (j < userParts.count()) && ((i + j) < users.count()); ++j)
-                {
-                    if (userParts[j] != users[i + j])
-                    {
-                        found = false;
-                        break;
-                    }
-                }
-                if (found)
-                {
-                    ids << matrixId;
-                    i += userParts.count() - 1;
-                    break;
-                }
+                ids << matrixId;
+                i += length - 1;
             }
-            // if there is no id found, leave it for the caller
-            if (!found)
+            else
             {
+                // if there is no id found, leave it for the caller
                 ids << accumulator;
             }
         }
@@ -152,7 +76,7 @@ QStringList Bot::userLookup(const QStringList& users)
 
 QString Bot::userLookup(const QString& userName)
 {
-    if (!m_room)
+    if (!hasTarget())
         return QString();
 
     QString n = userName.trimmed();
@@ -162,27 +86,16 @@ QString Bot::userLookup(const QString& userName)
     if (n.startsWith('@') && n.contains(':'))
         return n;
 
-    for (const auto& u : m_room->users())
+    const QStringList ids = m_members.ids(n);
+    if (ids.count() > 1)
     {
-        if (n == u->displayname(m_room))
-            return u->id();
+        QStringList sortedIds(ids);
+        sortedIds.sort();
+        message(QString("'%1' is ambiguous, it could be %2.").arg(n, sortedIds.join(QStringLiteral(", "))));
+        return QString();
     }
 
-    return QString();
-}
-
-QStringList Bot::userIds()
-{
-    QStringList l;
-    if (!m_room)
-        return l;
-
-    m_room->setDisplayed(true);
-    for (const auto& u : m_room->users())
-    {
-        l << u->id();
-    }
-    return l;
+    return ids.isEmpty() ? QString() : ids.first();
 }
 
 QString Bot::botUser() const
@@ -191,7 +104,8 @@ QString Bot::botUser() const
 }
 
 
-static int instance_count = 0;
+// Bots may live on different threads, see Shard
+static std::atomic<int> instance_count { 0 };
 
 static void bailOut(int timeout = 0)
 {
@@ -202,6 +116,7 @@ static void bailOut(int timeout = 0)
 Bot::Bot(QMatrixClient::Connection& conn, const QString& roomName, const QStringList& ops)
     : QObject()
     , m_conn(conn)
+    , m_outbox(new Outbox(this))
     , m_roomName(roomName)
 {
     instance_count++;
@@ -245,6 +160,20 @@ Bot::Bot(QMatrixClient::Connection& conn, const QString& roomName, const QString
                     m_room->checkVersion();
                     qDebug() << "Room version" << m_room->version();
                     m_room->setDisplayed(true);  // Force non-lazy load
+                    m_outbox->setRoom(m_room);
+                    loadMembers();
+                    connect(m_room,
+                            &QMatrixClient::Room::userAdded,
+                            this,
+                            [this](QMatrixClient::User* u) { m_members.insert(u->id(), u->displayname(m_room)); });
+                    connect(m_room,
+                            &QMatrixClient::Room::memberRenamed,
+                            this,
+                            [this](QMatrixClient::User* u) { m_members.insert(u->id(), u->displayname(m_room)); });
+                    connect(m_room,
+                            &QMatrixClient::Room::userRemoved,
+                            this,
+                            [this](QMatrixClient::User* u) { m_members.remove(u->id()); });
                     // Some rooms never generate a baseStateLoaded signal, so just wait 10sec
                     QTimer::singleShot(10000, this, &Bot::baseStateLoaded);
                     connect(m_room, &QMatrixClient::Room::baseStateLoaded, this, &Bot::baseStateLoaded);
@@ -259,16 +188,36 @@ Bot::Bot(QMatrixClient::Connection& conn, const QString& roomName, const QString
     }
 }
 
+Bot::Bot(Quotient::Connection& conn, const QString& roomName, const QStringList& ops, Offline)
+    : QObject()
+    , m_conn(conn)
+    , m_outbox(new Outbox(this))
+    , m_roomName(roomName)
+    , m_newlyConnected(false)
+    , m_offline(true)
+{
+    instance_count++;
+    setupWatchers();
+    for (const auto& u : ops)
+    {
+        setOps(u, true);
+    }
+}
+
 Bot::~Bot()
 {
+    // Sends whatever is still queued, before leaving
+    m_outbox->flush();
+    delete m_outbox;
+    m_outbox = nullptr;
+
     if (m_room)
     {
         m_room->leaveRoom();
     }
     qDeleteAll(m_watchers);
 
-    instance_count--;
-    if (instance_count < 1)
+    if (--instance_count < 1)
     {
         bailOut(3000);  // give some time for messages to be delivered
     }
@@ -281,6 +230,16 @@ void Bot::baseStateLoaded()
         m_newlyConnected = false;
         qDebug() << "Room base state loaded"
                  << "id=" << m_room->id() << "name=" << m_room->displayName() << "topic=" << m_room->topic();
+        loadMembers();
+    }
+}
+
+void Bot::loadMembers()
+{
+    m_members.clear();
+    for (const auto& u : m_room->users())
+    {
+        m_members.insert(u->id(), u->displayname(m_room));
     }
 }
 
@@ -298,6 +257,33 @@ private:
     Bot* m_b;
 };
 
+/// @brief RAII helper to add up the time spent in a watcher, if @p times is set
+class WatcherTimer
+{
+public:
+    WatcherTimer(QHash<QString, qint64>* times, const Watcher* w)
+        : m_times(times)
+        , m_w(w)
+    {
+        if (m_times)
+        {
+            m_timer.start();
+        }
+    }
+    ~WatcherTimer()
+    {
+        if (m_times)
+        {
+            (*m_times)[m_w->moduleName()] += m_timer.nsecsElapsed();
+        }
+    }
+
+private:
+    QHash<QString, qint64>* m_times;
+    const Watcher* m_w;
+    QElapsedTimer m_timer;
+};
+
 void Bot::addedMessages(int from, int to)
 {
     if (m_newlyConnected)
@@ -320,57 +306,49 @@ void Bot::addedMessages(int from, int to)
                          << QDateTime::currentDateTimeUtc().toString();
                 first = false;
             }
-            for (const auto& w : m_watchers)
-            {
-                w->handleMessage(event);
-            }
+            processMessage(event);
+        }
+    }
+    m_room->markMessagesAsRead(timeline[to]->id());
+}
 
-            CommandArgs cmd(event);
-            if (cmd.isValid())
-            {
-                Flusher f(this);
-                bool handled = false;
-                for (const auto& w : m_watchers)
-                {
-                    if (w->moduleName() == cmd.command)
-                    {
-                        cmd.pop();
-                        w->handleCommand(cmd);
-                        handled = true;
-                        break;
-                    }
-                }
+void Bot::processMessage(const Quotient::RoomMessageEvent* event)
+{
+    for (const auto& w : m_messageWatchers)
+    {
+        WatcherTimer t(m_profile ? &m_watcherTime : nullptr, w);
+        w->handleMessage(event);
+    }
 
-                if (handled)
-                {
-                    continue;
-                }
+    // Most messages are not commands: don't tokenize those at all
+    if (!CommandArgs::isCommand(event))
+    {
+        return;
+    }
 
-                if (m_ambiguousCommands.contains(cmd.command))
-                {
-                    message(QString("'%1' is ambiguous. Please use a module command.").arg(cmd.command));
-                }
-                else
-                {
-                    for (const auto& w : m_watchers)
-                    {
-                        if (w->moduleCommands().contains(cmd.command))
-                        {
-                            w->handleCommand(cmd);
-                            handled = true;
-                            break;
-                        }
-                    }
-
-                    if (!handled)
-                    {
-                        message(QString("I don't understand '%1'.").arg(cmd.command));
-                    }
-                }
+    CommandArgs cmd(event);
+    if (cmd.isValid())
+    {
+        Flusher f(this);
+        const auto route = m_routes.constFind(cmd.command);
+        if (route == m_routes.constEnd())
+        {
+            message(QString("I don't understand '%1'.").arg(cmd.command));
+        }
+        else if (route->kind == Route::Kind::Ambiguous)
+        {
+            message(QString("'%1' is ambiguous. Please use a module command.").arg(cmd.command));
+        }
+        else
+        {
+            if (route->kind == Route::Kind::Module)
+            {
+                cmd.pop();
             }
+            WatcherTimer t(m_profile ? &m_watcherTime : nullptr, route->watcher);
+            route->watcher->handleCommand(cmd);
         }
     }
-    m_room->markMessagesAsRead(timeline[to]->id());
 }
 
 bool Bot::setOps(const QString& user, bool op)
@@ -421,19 +399,19 @@ bool Bot::checkOps(const QuatBot::CommandArgs& cmd)
 
 void Bot::message(const QStringList& l)
 {
-    if (!m_room)
+    if (!hasTarget())
         return;
     message(l.join(' '));
 }
 
 void Bot::message(const QString& s)
 {
-    if (!m_room)
+    if (!hasTarget())
         return;
     if (s.isEmpty())
         return;
     m_accumulatedMessages.append(s);
-    for (const auto& p : m_watchers)
+    for (const auto& p : m_botMessageWatchers)
         p->handleMessage(s);
 }
 
@@ -441,16 +419,36 @@ void Bot::message(Bot::Flush)
 {
     if (!m_accumulatedMessages.isEmpty())
     {
-        m_room->postPlainText(m_accumulatedMessages.join('\n'));
+        m_outbox->post(m_accumulatedMessages.join('\n'));
         m_accumulatedMessages.clear();
     }
 }
 
+void Bot::setMessageWindow(int milliseconds)
+{
+    m_outbox->setWindow(milliseconds);
+}
+
+void Bot::setOutbox(Outbox* outbox)
+{
+    if (outbox && (outbox != m_outbox))
+    {
+        outbox->setParent(this);
+        outbox->setWindow(m_outbox->window());
+        outbox->setRoom(m_room);
+        m_outbox->flush();
+        delete m_outbox;
+        m_outbox = outbox;
+    }
+}
+
 Watcher* Bot::getWatcher(const QString& name)
 {
-    for (const auto& w : m_watchers)
-        if (w->moduleName() == name)
-            return w;
+    const auto route = m_routes.constFind(name);
+    if ((route != m_routes.constEnd()) && (route->kind == Route::Kind::Module))
+    {
+        return route->watcher;
+    }
     return nullptr;
 }
 
@@ -472,11 +470,6 @@ QStringList Bot::operatorIds()
     return m_operators.values();
 }
 
-static QSet<QString> commandSet(const QStringList& commands)
-{
-    return QSet<QString>(commands.begin(), commands.end());
-}
-
 void Bot::setupWatchers()
 {
     m_watchers.reserve(6);
@@ -487,25 +480,52 @@ void Bot::setupWatchers()
     m_watchers.append(new Coffee(this));
 #endif
 
-    QSet<QString> commands;
     for (const auto& w : m_watchers)
     {
+        const auto interests = w->interests();
+        if (interests.testFlag(Watcher::Interest::Messages))
+        {
+            m_messageWatchers.append(w);
+        }
+        if (interests.testFlag(Watcher::Interest::BotMessages))
+        {
+            m_botMessageWatchers.append(w);
+        }
+    }
+
+    // Module names take precedence over the subcommands of any module.
+    for (const auto& w : m_watchers)
+    {
+        if (!w->moduleName().isEmpty())
+        {
+            m_routes.insert(w->moduleName(), { Route::Kind::Module, w });
+        }
+    }
+
+    // The "basic commands" are always interpreted by basic (because it's first)
+    // so those are never ambiguous. For the others, a command understood by
+    // more than one module needs the module name to disambiguate.
+    for (const auto& w : m_watchers)
+    {
+        if (!w->interests().testFlag(Watcher::Interest::Commands))
+        {
+            continue;
+        }
         for (const auto& cmd : w->moduleCommands())
         {
-            if (commands.contains(cmd))
+            auto route = m_routes.find(cmd);
+            if (route == m_routes.end())
             {
-                m_ambiguousCommands.insert(cmd);
+                m_routes.insert(cmd, { Route::Kind::Command, w });
             }
-            else
+            else if ((route->kind == Route::Kind::Command) && (route->watcher != w)
+                     && (route->watcher != m_watchers[0]))
             {
-                commands.insert(cmd);
+                route->kind = Route::Kind::Ambiguous;
+                route->watcher = nullptr;
             }
         }
     }
-
-    // Except that the "basic commands" are always interpreted by basic (because it's first)
-    // so those are not considered ambiguous.
-    m_ambiguousCommands.subtract(commandSet(m_watchers[0]->moduleCommands()));
 }
 
 }  // namespace QuatBot
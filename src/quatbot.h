@@ -8,6 +8,9 @@
 #ifndef QUATBOT_QUATBOT_H
 #define QUATBOT_QUATBOT_H
 
+#include "members.h"
+
+#include <QHash>
 #include <QObject>
 #include <QSet>
 #include <QString>
@@ -17,11 +20,13 @@ namespace Quotient
 {
 class Connection;
 class Room;
+class RoomMessageEvent;
 }  // namespace Quotient
 
 namespace QuatBot
 {
 struct CommandArgs;
+class Outbox;
 class Watcher;
 
 /** @brief Top-level class for the QuatBot
@@ -82,6 +87,8 @@ public:
      * a command is issued that names people (e.g. ~op).
      * 
      * This method looks up a Matrix-id for the nicknames @p userName.
+     * If more than one member of the room uses that nickname, a message
+     * listing them is sent to the room and an empty string is returned.
      */
     QString userLookup(const QString& userName);
     /** @brief Looks up matrix ids based on expanded nicknames
@@ -100,8 +107,16 @@ public:
      */
     QStringList userLookup(const QStringList& users);
 
-    /// @brief All the user ids from the room
-    QStringList userIds();
+    /** @brief All the user ids from the room, in the room's order
+     *
+     * This is a snapshot of the members, which is cheap to copy;
+     * use isMember() to check a single id.
+     */
+    QStringList memberIds() const { return m_members.memberIds(); }
+    /// @brief Is @p id a member of the room?
+    bool isMember(const QString& id) const { return m_members.contains(id); }
+    /// @brief Number of members of the room
+    int memberCount() const { return m_members.count(); }
     /// @brief User id of the bot user itself
     QString botUser() const;
     /// @brief Room name this bot is attached to
@@ -122,9 +137,47 @@ public:
     struct Flush
     {
     };  ///< Tag class
-    /// @brief Flushes the message queue.
+    /** @brief Flushes the message queue.
+     *
+     * The collected messages are handed to the outbox, which sends
+     * them as soon as the server is ready for them; flushes that
+     * happen while a message is on its way to the server are
+     * combined into one message.
+     */
     void message(Flush);
 
+    /** @brief Sets the time to collect outgoing messages
+     *
+     * Messages flushed within @p milliseconds of each other are sent
+     * as a single Matrix message. See Outbox::setWindow().
+     */
+    void setMessageWindow(int milliseconds);
+    /// @brief The outgoing message queue, for statistics
+    const Outbox& outbox() const { return *m_outbox; }
+    /** @brief Replaces the outgoing message queue
+     *
+     * The bot takes ownership of @p outbox. This is used to send messages
+     * somewhere other than the room, e.g. when replaying events.
+     */
+    void setOutbox(Outbox* outbox);
+
+    /** @brief Handles one message from the room
+     *
+     * Passes the message to the watchers, and if it is a command,
+     * passes the command to the watcher responsible for it.
+     * Messages sent in response are flushed afterwards.
+     */
+    void processMessage(const Quotient::RoomMessageEvent* event);
+
+    /** @brief Switches timing of the watchers on or off
+     *
+     * When on, the time spent in each watcher is added up;
+     * see watcherTimes().
+     */
+    void setProfiling(bool on) { m_profile = on; }
+    /// @brief Nanoseconds spent in each watcher (by module name) while profiling
+    QHash<QString, qint64> watcherTimes() const { return m_watcherTime; }
+
     /** @brief Get the watcher with the given @p name
      * 
      * In some cases one Watcher needs to use a service from another,
@@ -138,8 +191,26 @@ public:
     QStringList operatorIds();
 
 protected:
+    /// @brief Tag class for a bot that does not join a room
+    struct Offline
+    {
+    };
+    /** @brief Create a bot that is not attached to any room
+     *
+     * Its watchers are set up immediately, and it only handles
+     * messages passed to processMessage(). Outgoing messages need
+     * an outbox set with setOutbox(). The members of the "room"
+     * are managed through members().
+     */
+    Bot(Quotient::Connection& conn, const QString& roomName, const QStringList& ops, Offline);
+
+    /// @brief Index of the members of the room
+    MemberIndex& members() { return m_members; }
+
     /// @brief Called once the room is loaded for the first time.
     void baseStateLoaded();
+    /// @brief (Re)builds the index of room members
+    void loadMembers();
     /// @brief Messages delivered by libqmatrixclient
     void addedMessages(int from, int to);
 
@@ -155,16 +226,43 @@ protected:
     void setupWatchers();
 
 private:
+    /** @brief Where does a command go?
+     *
+     * Built once in setupWatchers(), so that dispatching a command
+     * is a single hash lookup on the command word.
+     */
+    struct Route
+    {
+        enum class Kind
+        {
+            Module,  ///< The command names a module; pop() and pass the subcommand
+            Command,  ///< The command is a subcommand of @c watcher
+            Ambiguous  ///< More than one module understands the command
+        };
+        Kind kind = Kind::Ambiguous;
+        Watcher* watcher = nullptr;
+    };
+
+    /// @brief Can the bot talk yet? A live bot needs its room; an Offline bot has none
+    bool hasTarget() const { return m_room || m_offline; }
+
     Quotient::Room* m_room = nullptr;
     Quotient::Connection& m_conn;
 
     QVector<Watcher*> m_watchers;
+    QVector<Watcher*> m_messageWatchers;  ///< Subscribed to messages from the server
+    QVector<Watcher*> m_botMessageWatchers;  ///< Subscribed to the bot's own messages
+    QHash<QString, Route> m_routes;
     QSet<QString> m_operators;
-    QSet<QString> m_ambiguousCommands;
+    MemberIndex m_members;
 
     QStringList m_accumulatedMessages;
+    Outbox* m_outbox = nullptr;
     QString m_roomName;
     bool m_newlyConnected = true;
+    bool m_offline = false;
+    bool m_profile = false;
+    QHash<QString, qint64> m_watcherTime;
 };
 }  // namespace QuatBot
 
@@ -0,0 +1,63 @@
+/*
+ *  SPDX-License-Identifier: BSD-2-Clause
+ *  SPDX-License-File: LICENSE
+ *
+ * Copyright 2026 Adriaan de Groot <groot@kde.org>
+ */
+
+#include "replay.h"
+
+#include <events/roommessageevent.h>
+
+#include <QTextStream>
+#include <QTimer>
+
+namespace QuatBot
+{
+QString RecordingOutbox::send(const QString& text)
+{
+    if (m_echo)
+    {
+        QTextStream out(stdout);
+        out << text << '\n';
+    }
+
+    const QString txnId = QString("replay-%1").arg(++m_postCount);
+    QTimer::singleShot(0, this, [this, txnId]() { sent(txnId); });
+    return txnId;
+}
+
+ReplayBot::ReplayBot(Quotient::Connection& conn, const QString& roomName, const QStringList& ops)
+    : Bot(conn, roomName, ops, Offline {})
+{
+}
+
+bool ReplayBot::replay(const QJsonObject& event)
+{
+    const QString type = event.value(QLatin1String("type")).toString();
+    if (type == QLatin1String("m.room.member"))
+    {
+        const QJsonObject content = event.value(QLatin1String("content")).toObject();
+        const QString id = event.value(QLatin1String("state_key")).toString();
+        if (content.value(QLatin1String("membership")).toString() == QLatin1String("join"))
+        {
+            // Like Quotient, fall back to the id if there is no display name
+            const QString displayName = content.value(QLatin1String("displayname")).toString();
+            members().insert(id, displayName.isEmpty() ? id : displayName);
+        }
+        else
+        {
+            members().remove(id);
+        }
+        return false;
+    }
+    if (type == QLatin1String("m.room.message"))
+    {
+        const Quotient::RoomMessageEvent message(event);
+        processMessage(&message);
+        return true;
+    }
+    return false;
+}
+
+}  // namespace QuatBot
@@ -0,0 +1,62 @@
+/*
+ *  SPDX-License-Identifier: BSD-2-Clause
+ *  SPDX-License-File: LICENSE
+ *
+ * Copyright 2026 Adriaan de Groot <groot@kde.org>
+ */
+
+#ifndef QUATBOT_REPLAY_H
+#define QUATBOT_REPLAY_H
+
+#include "outbox.h"
+#include "quatbot.h"
+
+#include <QJsonObject>
+#include <QString>
+#include <QStringList>
+
+namespace QuatBot
+{
+/** @brief Outbox that records messages instead of sending them
+ *
+ * Each message is "confirmed" on the next pass through the
+ * event loop, so the outbox behaves as it would with a very
+ * fast homeserver.
+ */
+class RecordingOutbox : public Outbox
+{
+public:
+    using Outbox::Outbox;
+
+    /// @brief Also print each message to standard output
+    void setEcho(bool echo) { m_echo = echo; }
+    /// @brief Number of messages "sent"
+    int postCount() const { return m_postCount; }
+
+protected:
+    QString send(const QString& text) override;
+
+private:
+    int m_postCount = 0;
+    bool m_echo = false;
+};
+
+/** @brief A bot that handles recorded events instead of a room
+ *
+ * Events are given as the JSON of Matrix client events (as they
+ * occur in the timeline of a sync or /messages response).
+ * Membership events update the members of the bot's "room",
+ * message events are handled as they would be when they arrive
+ * from the homeserver; all other events are ignored.
+ */
+class ReplayBot : public Bot
+{
+public:
+    ReplayBot(Quotient::Connection& conn, const QString& roomName, const QStringList& ops);
+
+    /// @brief Handles one event; returns @c true if it was a message
+    bool replay(const QJsonObject& event);
+};
+
+}  // namespace QuatBot
+#endif
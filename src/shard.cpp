@@ -0,0 +1,98 @@
+/*
+ *  SPDX-License-Identifier: BSD-2-Clause
+ *  SPDX-License-File: LICENSE
+ *
+ * Copyright 2026 Adriaan de Groot <groot@kde.org>
+ */
+
+#include "shard.h"
+
+#include <QDebug>
+#include <QNetworkReply>
+#include <QObject>
+#include <QVector>
+
+#include <connection.h>
+#include <networkaccessmanager.h>
+
+namespace QuatBot
+{
+Shard::Shard(int index, const QStringList& rooms, BotFactory factory)
+    : m_index(index)
+    , m_rooms(rooms)
+    , m_factory(std::move(factory))
+{
+}
+
+Shard::~Shard()
+{
+    m_thread.quit();
+    m_thread.wait();
+}
+
+void Shard::start(const Quotient::Connection& conn, const QString& password)
+{
+    const QUrl homeserver = conn.homeserver();
+    const QString userId = conn.userId();
+    const QString deviceName = QString("quatbot-shard%1").arg(m_index);
+
+    // Everything created from here on lives in the shard's thread
+    auto* context = new QObject;
+    context->moveToThread(&m_thread);
+    QObject::connect(&m_thread, &QThread::finished, context, &QObject::deleteLater);
+    m_thread.start();
+
+    QMetaObject::invokeMethod(
+        context,
+        [this, context, homeserver, userId, password, deviceName]()
+        {
+            // The network access manager is per-thread
+            QObject::connect(
+                QMatrixClient::NetworkAccessManager::instance(),
+                &QNetworkAccessManager::sslErrors,
+                [](QNetworkReply* reply, const QList<QSslError>& errors) { reply->ignoreSslErrors(errors); });
+
+            auto* shardConn = new QMatrixClient::Connection(homeserver, context);
+            QObject::connect(shardConn,
+                             &QMatrixClient::Connection::connected,
+                             context,
+                             [this, shardConn]()
+                             {
+                                 qDebug() << "Shard" << shardConn->deviceId() << "connected for" << m_rooms;
+                                 shardConn->setLazyLoading(false);
+                                 shardConn->syncLoop();
+                                 for (const auto& r : m_rooms)
+                                 {
+                                     m_factory(*shardConn, r);
+                                 }
+                             });
+            QObject::connect(shardConn,
+                             &QMatrixClient::Connection::loginError,
+                             context,
+                             [this]() { qWarning() << "Shard could not connect for" << m_rooms; });
+            shardConn->connectToServer(userId, password, deviceName);
+        },
+        Qt::QueuedConnection);
+}
+
+QList<Shard*> makeShards(const QStringList& rooms, int count, const Shard::BotFactory& factory)
+{
+    count = qBound(1, count, qMax(1, rooms.count()));
+    QVector<QStringList> assignment(count);
+    for (int i = 0; i < rooms.count(); ++i)
+    {
+        assignment[i % count].append(rooms[i]);
+    }
+
+    QList<Shard*> shards;
+    for (const auto& r : assignment)
+    {
+        if (!r.isEmpty())
+        {
+            shards.append(new Shard(shards.count() + 1, r, factory));
+        }
+    }
+    return shards;
+}
+
+}  // namespace QuatBot
@@ -0,0 +1,73 @@
+/*
+ *  SPDX-License-Identifier: BSD-2-Clause
+ *  SPDX-License-File: LICENSE
+ *
+ * Copyright 2026 Adriaan de Groot <groot@kde.org>
+ */
+
+#ifndef QUATBOT_SHARD_H
+#define QUATBOT_SHARD_H
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QThread>
+
+#include <functional>
+
+namespace Quotient
+{
+class Connection;
+}  // namespace Quotient
+
+namespace QuatBot
+{
+/** @brief A thread running the bots for some of the rooms
+ *
+ * Normally, all the bots share one connection and run on the main
+ * thread, so one slow room holds up all the others. A shard is a
+ * thread with its own event loop and its own connection to the
+ * homeserver, logged in as the same user but as a device of its
+ * own (`quatbot-shard<n>`), so that the shards do not share a
+ * session. Each shard syncs by itself, so the sync results for its
+ * rooms are delivered on the shard's thread, where the bots for its
+ * rooms live.
+ *
+ * That is not free: the server sends every sync stream all of the
+ * user's rooms, so each shard adds a full sync (and a device to the
+ * user's device list). Use shards for a few busy rooms, not many.
+ */
+class Shard
+{
+public:
+    /// @brief Called on the shard's thread to create the bot for a room
+    using BotFactory = std::function<void(Quotient::Connection&, const QString&)>;
+
+    Shard(int index, const QStringList& rooms, BotFactory factory);
+    ~Shard();
+
+    /** @brief Starts the thread and logs in as the user of @p conn
+     *
+     * The connection @p conn must already be connected; the shard
+     * takes its homeserver and user, and logs in with @p password
+     * as a device of its own.
+     */
+    void start(const Quotient::Connection& conn, const QString& password);
+
+    const QStringList& rooms() const { return m_rooms; }
+
+private:
+    int m_index;
+    QStringList m_rooms;
+    BotFactory m_factory;
+    QThread m_thread;
+};
+
+/** @brief Distributes @p rooms over (up to) @p count shards
+ *
+ * Rooms are assigned round-robin; no empty shards are created.
+ */
+QList<Shard*> makeShards(const QStringList& rooms, int count, const Shard::BotFactory& factory);
+
+}  // namespace QuatBot
+#endif
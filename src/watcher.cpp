@@ -9,35 +9,24 @@
 
 #include <room.h>
 
+#include <QJsonObject>
+#include <QJsonValue>
+
 namespace QuatBot
 {
 static constexpr const QChar COMMAND_PREFIX('~');  // 0x1575); // ᕵ Nunavik Hi
 
-static QString munge(const QString& s)
-{
-    return s.trimmed();
-}
-
-CommandArgs::CommandArgs(QString s)
+CommandArgs::CommandArgs(QStringView s)
 {
     if (isCommand(s))
     {
-        QStringList parts = s.remove(0, 1).split(' ');
-        QStringList r;
-        // Skipping over the first, that's the command
-        for (int i = 1; i < parts.count(); ++i)
-        {
-            r << munge(parts[i]);
-        }
-
-        command = munge(parts[0]);
-        args = r;
+        tokenize(s.mid(1));
     }
 }
 
 CommandArgs::CommandArgs(const QString& s, InternalCommand m)
-    : CommandArgs(isCommand(s) ? s : (COMMAND_PREFIX + s))
 {
+    tokenize(isCommand(s) ? QStringView(s).mid(1) : QStringView(s));
     user = QStringLiteral("(internal)");
     internalOperator = true;
 }
@@ -50,15 +39,45 @@ CommandArgs::CommandArgs(const QMatrixClient::RoomMessageEvent* e)
 }
 
 
-bool CommandArgs::isCommand(const QString& s)
+bool CommandArgs::isCommand(QStringView s)
 {
     return s.startsWith(COMMAND_PREFIX);
 }
 
 bool CommandArgs::isCommand(const QMatrixClient::RoomMessageEvent* e)
 {
-    // There must be a faster way, by looking at raw data
-    return isCommand(e->plainBody());
+    // Look at the body in the raw content JSON, so that non-text
+    // bodies are rejected early. Qt's JSON API has no view of a
+    // string value, so this still copies the body into a QString;
+    // what it saves is building (and tokenizing) a CommandArgs.
+    static const QLatin1String bodyKey("body");
+    const QJsonValue body = e->contentJson().value(bodyKey);
+    return body.isString() && isCommand(body.toString());
+}
+
+void CommandArgs::tokenize(QStringView s)
+{
+    // Words are separated by single spaces, so multiple spaces
+    // produce empty arguments; each word is trimmed of other whitespace.
+    bool first = true;
+    decltype(s.size()) wordStart = 0;
+    for (decltype(s.size()) i = 0; i <= s.size(); ++i)
+    {
+        if ((i == s.size()) || (s[i] == ' '))
+        {
+            const QStringView word = s.mid(wordStart, i - wordStart).trimmed();
+            if (first)
+            {
+                command = word.toString();
+                first = false;
+            }
+            else
+            {
+                args.append(word.toString());
+            }
+            wordStart = i + 1;
+        }
+    }
 }
 
 bool CommandArgs::pop()
@@ -88,6 +107,11 @@ QString Watcher::displayCommand(const QString& s)
     return QString("%1%2").arg(COMMAND_PREFIX).arg(s);
 }
 
+Watcher::Interests Watcher::interests() const
+{
+    return Interest::Messages | Interest::Commands;
+}
+
 void Watcher::handleMessage(const QString&) {}
 
 }  // namespace QuatBot
@@ -10,8 +10,10 @@
 
 #include "quatbot.h"
 
+#include <QFlags>
 #include <QString>
 #include <QStringList>
+#include <QStringView>
 
 namespace Quotient
 {
@@ -41,9 +43,10 @@ struct CommandArgs
      * 
      * This kind of command does not carry id or user information.
      * If the string does not start with COMMAND_PREFIX, creates
-     * an invalid command.
+     * an invalid command. The string is only read; the command
+     * and arguments are copied out of it.
      */
-    explicit CommandArgs(QString);  // Copied because it's modified in the method
+    explicit CommandArgs(QStringView);
     explicit CommandArgs(const QString& s, InternalCommand m);
 
     /** @brief Build a command list from an event.
@@ -55,7 +58,7 @@ struct CommandArgs
     explicit CommandArgs(const Quotient::RoomMessageEvent*);
 
     /// @brief Checks @p s for COMMAND_PREFIX
-    static bool isCommand(const QString& s);
+    static bool isCommand(QStringView s);
     /// @brief Checks @p e for COMMAND_PREFIX at the start of the message text
     static bool isCommand(const Quotient::RoomMessageEvent* e);
 
@@ -75,6 +78,15 @@ struct CommandArgs
      */
     bool pop();
 
+private:
+    /** @brief Splits @p s (without COMMAND_PREFIX) into command and args
+     *
+     * This is a single scan over @p s; the words are slices of
+     * @p s until they are stored in the command or arguments.
+     */
+    void tokenize(QStringView s);
+
+public:
     QString id;  ///< event Id, if available.
     QString user;  ///< user Id, if available. Used for access-control (ops)
     QString command;
@@ -99,10 +111,22 @@ struct CommandArgs
  * of commands it handles. The Watcher with name "log" responds to
  * commands that start "~log" and processes those. One special
  * subclass of Watcher handles "the rest".
+ *
+ * A Watcher declares which of these it is interested in, through
+ * interests(); the bot only calls the handlers for those.
  */
 class Watcher
 {
 public:
+    /// @brief Kinds of events that a watcher can subscribe to
+    enum class Interest
+    {
+        Messages = 0x1,  ///< handleMessage() for each message from the Matrix server
+        BotMessages = 0x2,  ///< handleMessage() for each "virtual" message sent by the bot
+        Commands = 0x4,  ///< handleCommand() for the commands of this module
+    };
+    Q_DECLARE_FLAGS(Interests, Interest)
+
     explicit Watcher(Bot* parent);
     virtual ~Watcher();
 
@@ -121,6 +145,15 @@ public:
      */
     virtual const QStringList& moduleCommands() const = 0;
 
+    /** @brief the kinds of events this module wants to handle
+     *
+     * This is consulted once, when the bot sets up its watchers.
+     * The default is messages from the server, and commands;
+     * override this to also see the bot's own messages, or to
+     * skip the (possibly empty) message handler altogether.
+     */
+    virtual Interests interests() const;
+
     /** @brief Handle "virtual" message sent by the bot
      * 
      * The default implementation does nothing.
@@ -159,5 +192,7 @@ protected:
     Bot* m_bot;
 };
 
+Q_DECLARE_OPERATORS_FOR_FLAGS(Watcher::Interests)
+
 }  // namespace QuatBot
 #endif
@@ -0,0 +1,114 @@
+/*
+ *  SPDX-License-Identifier: BSD-2-Clause
+ *  SPDX-License-File: LICENSE
+ *
+ * Copyright 2026 Adriaan de Groot <groot@kde.org>
+ */
+
+#include "eventlog.h"
+
+#include <QTemporaryDir>
+#include <QTest>
+#include <QtEndian>
+
+using namespace QuatBot;
+
+class EventLogTest : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void testSenders();
+    void testDamagedSender_data();
+    void testDamagedSender();
+
+private:
+    /// @brief Writes an event log with @p records (after the magic) and returns its name
+    QString writeLog(const QByteArray& records);
+
+    QTemporaryDir m_dir;
+    int m_count = 0;
+};
+
+/// @brief Encodes one record of @p kind
+static QByteArray record(EventLog::Kind kind, const QByteArray& payload)
+{
+    QByteArray r(4, '\0');
+    qToLittleEndian<quint32>(quint32(payload.size() + 1), r.data());
+    r.append(char(kind));
+    r.append(payload);
+    return r;
+}
+
+static QByteArray senderRecord(quint32 index, const QByteArray& id)
+{
+    QByteArray payload(4, '\0');
+    qToLittleEndian<quint32>(index, payload.data());
+    return record(EventLog::Kind::Sender, payload + id);
+}
+
+static QByteArray eventRecord(quint32 sender, const QByteArray& id, const QByteArray& body)
+{
+    QByteArray payload(8 + 4 + 2, '\0');
+    qToLittleEndian<qint64>(1000, payload.data());
+    qToLittleEndian<quint32>(sender, payload.data() + 8);
+    qToLittleEndian<quint16>(quint16(id.size()), payload.data() + 12);
+    return record(EventLog::Kind::Event, payload + id + body);
+}
+
+QString EventLogTest::writeLog(const QByteArray& records)
+{
+    const QString fileName = m_dir.filePath(QString("log%1.events").arg(m_count++));
+    QFile f(fileName);
+    if (f.open(QFile::WriteOnly))
+    {
+        f.write("QBE1");
+        f.write(records);
+    }
+    return fileName;
+}
+
+void EventLogTest::testSenders()
+{
+    const QString fileName = writeLog(senderRecord(0, "@alice:kde.org") + eventRecord(0, "$1", "hello")
+                                      + senderRecord(1, "@bob:kde.org") + eventRecord(1, "$2", "hi"));
+    EventLogReader reader(fileName);
+    QVERIFY(reader.isValid());
+
+    EventRecord r;
+    QVERIFY(reader.next(r));
+    QCOMPARE(reader.sender(r.sender), QStringLiteral("@alice:kde.org"));
+    QVERIFY(reader.next(r));
+    QCOMPARE(reader.sender(r.sender), QStringLiteral("@bob:kde.org"));
+    QCOMPARE(r.body, QByteArray("hi"));
+    QVERIFY(!reader.next(r));
+    QCOMPARE(reader.senders().count(), 2);
+}
+
+void EventLogTest::testDamagedSender_data()
+{
+    QTest::addColumn<quint32>("index");
+    QTest::newRow("skips one") << quint32(2);
+    QTest::newRow("huge") << quint32(0x7fffffff);
+    QTest::newRow("negative as int") << quint32(0x80000000);
+    QTest::newRow("max") << quint32(0xffffffff);
+}
+
+void EventLogTest::testDamagedSender()
+{
+    QFETCH(quint32, index);
+    const QString fileName = writeLog(senderRecord(0, "@alice:kde.org") + eventRecord(0, "$1", "hello")
+                                      + senderRecord(index, "@mallory:kde.org") + eventRecord(0, "$2", "after"));
+    EventLogReader reader(fileName);
+    QVERIFY(reader.isValid());
+
+    EventRecord r;
+    QVERIFY(reader.next(r));
+    QCOMPARE(r.body, QByteArray("hello"));
+    // The damaged record ends the log, like any other damage
+    QVERIFY(!reader.next(r));
+    QCOMPARE(reader.senders().count(), 1);
+}
+
+QTEST_GUILESS_MAIN(EventLogTest)
+
+#include "eventlog.moc"
@@ -0,0 +1,81 @@
+/*
+ *  SPDX-License-Identifier: BSD-2-Clause
+ *  SPDX-License-File: LICENSE
+ *
+ * Copyright 2026 Adriaan de Groot <groot@kde.org>
+ */
+
+#include "logindex.h"
+#include "logpaths.h"
+
+#include <QTemporaryDir>
+#include <QTest>
+
+using namespace QuatBot;
+
+class LogSearchTest : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void initTestCase();
+    void testNotesName();
+    void testRoomsAreSeparate();
+
+private:
+    /// @brief Writes @p messages to the notes index of @p room
+    void writeNotes(const QString& room, const QStringList& messages);
+
+    QTemporaryDir m_root;
+};
+
+void LogSearchTest::initTestCase()
+{
+    QVERIFY(m_root.isValid());
+    LogPaths::setRoot(m_root.path());
+}
+
+void LogSearchTest::testNotesName()
+{
+    const QDate date(2026, 10, 17);
+    QCOMPARE(LogPaths::notesName(QStringLiteral("#quatbot:kde.org"), date),
+             QStringLiteral("notes_quatbotkdeorg_2026_42"));
+}
+
+void LogSearchTest::writeNotes(const QString& room, const QStringList& messages)
+{
+    // The writer is done (and everything is on disk) once it is destroyed
+    LogIndexWriter writer(LogPaths::resolve(LogPaths::notesName(room, QDate::currentDate()))
+                          + QStringLiteral(".index"));
+    QVERIFY(writer.open());
+    for (const auto& m : messages)
+    {
+        writer.add(QDateTime::currentDateTimeUtc(), QStringLiteral("@alice:kde.org"), m);
+    }
+}
+
+void LogSearchTest::testRoomsAreSeparate()
+{
+    // Room B's name starts with room A's, so a wildcard on the name alone is not enough
+    const QString roomA = QStringLiteral("#team");
+    const QString roomB = QStringLiteral("#team_secret");
+    writeNotes(roomA, { QStringLiteral("the budget is fine") });
+    writeNotes(roomB, { QStringLiteral("the budget is secret") });
+
+    const QStringList filesA = LogPaths::findNotes(roomA, QStringLiteral(".index"));
+    QCOMPARE(filesA.count(), 1);
+    const auto resultsA = LogSearch::instance().search(filesA, { QStringLiteral("budget") }, 5);
+    QCOMPARE(resultsA.count(), 1);
+    QCOMPARE(resultsA.first().message, QStringLiteral("the budget is fine"));
+
+    const auto secretsA = LogSearch::instance().search(filesA, { QStringLiteral("secret") }, 5);
+    QVERIFY(secretsA.isEmpty());
+
+    const QStringList filesB = LogPaths::findNotes(roomB, QStringLiteral(".index"));
+    const auto resultsB = LogSearch::instance().search(filesB, { QStringLiteral("budget") }, 5);
+    QCOMPARE(resultsB.count(), 1);
+    QCOMPARE(resultsB.first().message, QStringLiteral("the budget is secret"));
+}
+
+QTEST_GUILESS_MAIN(LogSearchTest)
+
+#include "logsearch.moc"